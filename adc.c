@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "latency.h"
+#include "adc.h"
+
+#if ADC_FILTER_SHIFT > 6
+#error "ADC_FILTER_SHIFT must be 6 or less"
+#endif
+
+// Converter input of each analog channel.
+static const uint8_t adc_mux[ADC_CHANNEL_COUNT] = { ADC_MUX_LEFT_FRONT, ADC_MUX_RIGHT_FRONT, ADC_MUX_BATTERY };
+
+// Channel averages scaled by 2^ADC_FILTER_SHIFT.
+static volatile uint16_t adc_filter[ADC_CHANNEL_COUNT];
+
+// Channels which have been seeded with their first sample.
+static uint8_t adc_seeded;
+
+// Channel of the conversion in progress and of the conversion after it.
+static uint8_t adc_channel;
+static uint8_t adc_channel_next;
+
+void adc_init(void)
+{
+    uint8_t i;
+
+    // Clear the channel averages.
+    for (i = 0; i < ADC_CHANNEL_COUNT; ++i) adc_filter[i] = 0;
+    adc_seeded = 0;
+
+    // In free running mode the next conversion has already started when a
+    // conversion completes, so the first two conversions both use channel 0.
+    adc_channel = 0;
+    adc_channel_next = 0;
+
+    // Disable the digital input buffers on the analog inputs.
+    for (i = 0; i < ADC_CHANNEL_COUNT; ++i) DIDR0 |= (1<<adc_mux[i]);
+
+    // Select AVCC as the reference and the first channel.
+    ADMUX = (0<<REFS1) | (1<<REFS0) |                       // AVCC with external capacitor at AREF.
+            (0<<ADLAR) |                                    // Right adjust the result.
+            adc_mux[0];                                     // First channel.
+
+    // Free running trigger source.
+    ADCSRB = (0<<ADTS2) | (0<<ADTS1) | (0<<ADTS0);
+
+    // Enable the converter and start free running conversions.
+    ADCSRA = (1<<ADEN) | (1<<ADSC) |                        // Enable and start converting.
+             (1<<ADATE) |                                   // Auto trigger from the free running source.
+             (1<<ADIF) |                                    // Clear any pending interrupt.
+             (1<<ADIE) |                                    // Interrupt on conversion complete.
+             (1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0);          // Clk/128 - 125 kHz converter clock.
+}
+
+
+uint16_t adc_get(uint8_t channel)
+// Return the average of the analog channel.  This never waits on the
+// converter, it only reads the latest average.
+{
+    uint16_t value;
+    uint8_t stamp;
+
+    // Disable interrupts while the 16-bit average is read.
+    LATENCY_CLI(stamp);
+
+    value = adc_filter[channel];
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
+
+    return value >> ADC_FILTER_SHIFT;
+}
+
+
+SIGNAL(SIG_ADC)
+// Handles the conversion complete interrupt.
+{
+    uint16_t sample;
+    uint16_t filter;
+
+    // Get the sample of the channel that just completed.
+    sample = ADC;
+
+    // Update the channel average, seeding it with its first sample.
+    if (adc_seeded & (1<<adc_channel))
+    {
+        filter = adc_filter[adc_channel];
+        filter += sample - (filter >> ADC_FILTER_SHIFT);
+        adc_filter[adc_channel] = filter;
+    }
+    else
+    {
+        adc_filter[adc_channel] = sample << ADC_FILTER_SHIFT;
+        adc_seeded |= (1<<adc_channel);
+    }
+
+    // The conversion which just started uses the channel selected previously.
+    adc_channel = adc_channel_next;
+
+    // Select the channel for the conversion after it.
+    if (++adc_channel_next >= ADC_CHANNEL_COUNT) adc_channel_next = 0;
+    ADMUX = (ADMUX & ~0x0F) | adc_mux[adc_channel_next];
+}
@@ -0,0 +1,49 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_ADC_H_
+#define _TB_ADC_H_ 1
+
+// Analog channels sampled round-robin by the converter.
+#define ADC_LEFT_FRONT          0
+#define ADC_RIGHT_FRONT         1
+#define ADC_BATTERY             2
+#define ADC_CHANNEL_COUNT       3
+
+// Converter input of each analog channel.
+#define ADC_MUX_LEFT_FRONT      0               // ADC0 on PC0.
+#define ADC_MUX_RIGHT_FRONT     1               // ADC1 on PC1.
+#define ADC_MUX_BATTERY         2               // ADC2 on PC2.
+
+// Exponential average weight.  Each sample contributes 1/2^shift of the
+// channel average.  The converter completes about 9600 samples a second
+// shared between the channels.  Limited to 6 so the average fits 16 bits.
+#define ADC_FILTER_SHIFT        4
+
+void adc_init(void);
+uint16_t adc_get(uint8_t channel);
+
+#endif // _TB_ADC_H_
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#include <avr/io.h>
+#include "adc.h"
+#include "motors.h"
+#include "battery.h"
+
+static uint16_t battery_mv;
+static uint8_t battery_low;
+
+void battery_init(void)
+{
+    // Assume a nominal battery until the first update.
+    battery_mv = BATTERY_NOMINAL_MV;
+    battery_low = 0;
+}
+
+
+void battery_update(void)
+// Update the battery voltage, the low battery state and the motor PWM
+// compensation from the filtered battery channel.
+{
+    uint16_t scale;
+
+    // Convert the filtered reading to millivolts at the battery.
+    battery_mv = (uint16_t) (((uint32_t) adc_get(ADC_BATTERY) * (BATTERY_REF_MV * BATTERY_DIVIDER)) >> 10);
+
+    // Update the low battery state with hysteresis.
+    if (battery_mv < BATTERY_LOW_MV) battery_low = 1;
+    if (battery_mv > BATTERY_RECOVER_MV) battery_low = 0;
+
+    // Scale the motor PWM by the nominal over the measured voltage.
+    if (battery_mv > ((BATTERY_NOMINAL_MV * (uint32_t) MOTORS_SCALE_UNITY) / BATTERY_SCALE_MAX))
+        scale = (uint16_t) (((uint32_t) BATTERY_NOMINAL_MV * MOTORS_SCALE_UNITY) / battery_mv);
+    else
+        scale = BATTERY_SCALE_MAX;
+
+    // Update the motor compensation.
+    motors_compensate(scale);
+}
+
+
+uint16_t battery_millivolts(void)
+// Return the battery voltage in millivolts.
+{
+    return battery_mv;
+}
+
+
+uint8_t battery_is_low(void)
+// Return true if the battery is low.
+{
+    return battery_low;
+}
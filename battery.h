@@ -0,0 +1,51 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_BATTERY_H_
+#define _TB_BATTERY_H_ 1
+
+// Converter reference and the battery voltage divider ratio.
+#define BATTERY_REF_MV          5000
+#define BATTERY_DIVIDER         2
+
+// Battery voltage the motor speeds were tuned at.  The motor PWM is scaled
+// by the nominal over the measured voltage so the average motor voltage
+// stays constant as the pack drains.  The scale is limited so a nearly
+// flat pack doesn't saturate the motors at every speed.
+#define BATTERY_NOMINAL_MV      7200
+#define BATTERY_SCALE_MAX       384                     // 1.5 in 8.8 fixed point.
+
+// Battery is low below the low voltage until it recovers above the
+// recover voltage.
+#define BATTERY_LOW_MV          6300
+#define BATTERY_RECOVER_MV      6600
+
+void battery_init(void);
+void battery_update(void);
+uint16_t battery_millivolts(void);
+uint8_t battery_is_low(void);
+
+#endif // _TB_BATTERY_H_
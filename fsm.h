@@ -38,64 +38,83 @@
 #ifndef _FSM_H_
 #define _FSM_H_ 1
 
+// Type holding a state label address.  Labels fit in 16 bits on the AVR
+// but a host build, such as the simulator, needs a pointer sized type.
+#ifndef FSM_STATE_TYPE
+#define FSM_STATE_TYPE                      uint16_t
+#endif
+
+// A host build driven by a virtual clock counts the state machine runs
+// which do not end blocked in a wait.  The clock skips the main loop
+// passes after one in which none did until an interrupt could unblock one.
+#ifdef TIMER_VIRTUAL
+extern uint8_t timer_busy;
+#define FSM_RUN()                           ++timer_busy
+#define FSM_BLOCKED()                       --timer_busy
+#else
+#define FSM_RUN()
+#define FSM_BLOCKED()
+#endif
+
 #define FSM_EXIT_STATE                      0
 #define FSM_LABLE(line)                     pstate ## line
 #define FSM_PSTATE(line)                    FSM_LABLE(line)
-#define FSM_BEGIN(first_state)              static uint16_t fsm_state = (uint16_t) &&first_state;   \
-                                            static uint16_t fsm_first = (uint16_t) &&first_state;   \
-                                            uint8_t fsm_suspend = 1;                                \
-                                            (void) fsm_first; (void) fsm_suspend;                   \
+#define FSM_BEGIN(first_state)              static FSM_STATE_TYPE fsm_state = (FSM_STATE_TYPE) &&first_state;   \
+                                            static FSM_STATE_TYPE fsm_first = (FSM_STATE_TYPE) &&first_state;   \
+                                            uint8_t fsm_suspend = 1;                                            \
+                                            (void) fsm_first; (void) fsm_suspend;                               \
+                                            FSM_RUN();                                                          \
                                             if (fsm_state) goto *((void*)fsm_state); else goto fsm_end;
-#define FSM_END                             fsm_end:                                                \
+#define FSM_END                             fsm_end:                                                            \
                                             return fsm_state;
 #define FSM_STATE_BEGIN(this_state)         this_state :                    
 #define FSM_STATE_END                       return fsm_state;               
 
-#define fsm_restart()                               \
-    fsm_state = fsm_first;                          \
+#define fsm_restart()                                    \
+    fsm_state = fsm_first;                               \
     return fsm_state;
 
-#define fsm_return()                                \
+#define fsm_return()                                     \
     return fsm_state;
 
-#define fsm_change_state(cond, next_state)          \
-    if (cond) {                                     \
-        fsm_state = (uint16_t) &&next_state;        \
-        return fsm_state;                           \
+#define fsm_change_state(cond, next_state)               \
+    if (cond) {                                          \
+        fsm_state = (FSM_STATE_TYPE) &&next_state;       \
+        return fsm_state;                                \
     }
 
-#define fsm_abort()                                 \
-    fsm_state = FSM_EXIT_STATE;                     \
+#define fsm_abort()                                      \
+    fsm_state = FSM_EXIT_STATE;                          \
     return fsm_state;
 
-#define fsm_exit()                                  \
-    fsm_state = (uint16_t) &&fsm_first;             \
+#define fsm_exit()                                       \
+    fsm_state = (FSM_STATE_TYPE) &&fsm_first;            \
     return FSM_EXIT_STATE;
 
-#define fsm_suspend()                               \
-    fsm_suspend = 0;                                \
-    fsm_state = (uint16_t) &&FSM_PSTATE(__LINE__);  \
-    FSM_PSTATE(__LINE__):                           \
+#define fsm_suspend()                                    \
+    fsm_suspend = 0;                                     \
+    fsm_state = (FSM_STATE_TYPE) &&FSM_PSTATE(__LINE__); \
+    FSM_PSTATE(__LINE__):                                \
     if (!fsm_suspend) return fsm_state;
 
-#define fsm_wait_until(condition)                   \
-    fsm_state = (uint16_t) &&FSM_PSTATE(__LINE__);  \
-    FSM_PSTATE(__LINE__):                           \
-    if (!(condition)) return fsm_state;
+#define fsm_wait_until(condition)                        \
+    fsm_state = (FSM_STATE_TYPE) &&FSM_PSTATE(__LINE__); \
+    FSM_PSTATE(__LINE__):                                \
+    if (!(condition)) { FSM_BLOCKED(); return fsm_state; }
 
-#define fsm_wait_while(condition)                   \
-    fsm_state = (uint16_t) &&FSM_PSTATE(__LINE__);  \
-    FSM_PSTATE(__LINE__):                           \
-    if (condition) return fsm_state;
+#define fsm_wait_while(condition)                        \
+    fsm_state = (FSM_STATE_TYPE) &&FSM_PSTATE(__LINE__); \
+    FSM_PSTATE(__LINE__):                                \
+    if (condition) { FSM_BLOCKED(); return fsm_state; }
 
-#define fsm_checkpoint()                            \
-    fsm_state = (uint16_t) &&FSM_PSTATE(__LINE__);  \
+#define fsm_checkpoint()                                 \
+    fsm_state = (FSM_STATE_TYPE) &&FSM_PSTATE(__LINE__); \
     FSM_PSTATE(__LINE__):
 
-#define fsm_is_running(fsm)                         \
+#define fsm_is_running(fsm)                              \
     (fsm != FSM_EXIT_STATE) 
 
-#define fsm_wait_exit(fsm)                          \
+#define fsm_wait_exit(fsm)                               \
     while (fsm_is_running(fsm))
 
 /*
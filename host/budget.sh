@@ -0,0 +1,107 @@
+#!/bin/sh
+# Static memory budget for the TableBot firmware.  Reports the flash and
+# RAM each module takes with its largest symbols, and the largest stack
+# frames from the -fstack-usage files next to the objects, then fails if
+# a limit is passed.
+#
+# usage: budget.sh [-r ram_max] [-f flash_max] [-s stack_reserve]
+#                  [-x frame_max] [-n nm] [-z size] object...
+#
+# The RAM budget is the static data plus the stack reserve, which must
+# cover the deepest call chain with the interrupts on top.  The stack
+# painting in stack.c shows how much of the reserve is used at run time.
+# On the AVR constant data which is not in program memory, such as string
+# literals, is copied to RAM so .rodata counts as both flash and RAM.
+
+ram_max=1024
+flash_max=16384
+stack_reserve=256
+frame_max=96
+nm=avr-nm
+size=avr-size
+
+while getopts "r:f:s:x:n:z:" opt; do
+    case $opt in
+        r) ram_max=$OPTARG ;;
+        f) flash_max=$OPTARG ;;
+        s) stack_reserve=$OPTARG ;;
+        x) frame_max=$OPTARG ;;
+        n) nm=$OPTARG ;;
+        z) size=$OPTARG ;;
+        *) echo "usage: $0 [-r ram_max] [-f flash_max] [-s stack_reserve] [-x frame_max] [-n nm] [-z size] object..." >&2
+           exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+    echo "$0: no objects" >&2
+    exit 2
+fi
+
+status=0
+ram_total=0
+flash_total=0
+
+printf "%-16s %7s %7s\n" "module" "flash" "ram"
+
+for object in "$@"; do
+    module=$(basename "$object" .o)
+
+    # Section sizes of the module.
+    sizes=$($size -A "$object" | awk '
+        $1 ~ /^\.text/   { text += $2 }
+        $1 ~ /^\.data/   { data += $2 }
+        $1 ~ /^\.rodata/ { rodata += $2 }
+        $1 ~ /^\.bss/    { bss += $2 }
+        END { print text + data + rodata, data + rodata + bss }')
+    flash=${sizes% *}
+    ram=${sizes#* }
+    flash_total=$((flash_total + flash))
+    ram_total=$((ram_total + ram))
+
+    printf "%-16s %7d %7d\n" "$module" "$flash" "$ram"
+
+    # The symbols taking RAM, largest first.
+    $nm -S --size-sort -r -t d "$object" | awk '
+        NF == 4 && $3 ~ /^[bBdDrR]$/ { printf "    %-28s %5d\n", $4, $2 }' | head -8
+done
+
+echo
+printf "%-16s %7d %7d\n" "total" "$flash_total" "$ram_total"
+printf "%-16s %7s %7d\n" "stack reserve" "" "$stack_reserve"
+printf "%-16s %7d %7d\n" "limit" "$flash_max" "$ram_max"
+
+# The largest stack frames.
+echo
+echo "largest stack frames"
+frames=""
+for object in "$@"; do
+    su="${object%.o}.su"
+    [ -f "$su" ] && frames="$frames $su"
+done
+if [ -n "$frames" ]; then
+    cat $frames | awk -F '\t' '{ n = split($1, where, ":"); printf "%5d %-8s %s\n", $2, $3, where[n] }' | sort -rn | head -10
+    largest=$(cat $frames | awk -F '\t' '$2 > max { max = $2 } END { print max + 0 }')
+else
+    echo "    no -fstack-usage files"
+    largest=0
+fi
+
+# Check the limits.
+echo
+if [ "$flash_total" -gt "$flash_max" ]; then
+    echo "FAIL: flash $flash_total over $flash_max"
+    status=1
+fi
+if [ $((ram_total + stack_reserve)) -gt "$ram_max" ]; then
+    echo "FAIL: ram $ram_total with a $stack_reserve byte stack reserve over $ram_max"
+    status=1
+fi
+if [ "$largest" -gt "$frame_max" ]; then
+    echo "FAIL: largest stack frame $largest over $frame_max"
+    status=1
+fi
+[ $status -eq 0 ] && echo "within budget"
+
+exit $status
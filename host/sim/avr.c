@@ -0,0 +1,520 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Simulated AVR peripherals.  Each step delivers the interrupts the
+    ATmega168 would raise in that time: the 100 Hz Timer0 tick, ADC
+    conversions, pin changes from the ground sensors and USART bytes to
+    and from the camera.  Timer1 is only read back as the motor PWM.
+
+    The inputs come from the world and the camera, or from a capture
+    being replayed.  Either way they pass through the same input
+    functions, which also write them to avr_capture while it is open,
+    so a replay delivers them to the firmware exactly as they were.
+
+    The peripherals always advance in fixed steps as the world and the
+    camera are integrated on them.  With event stepping the firmware main
+    loop is skipped instead while it would do nothing: after a pass in
+    which every state machine stayed blocked in a wait, no pass is made
+    until the Timer0 tick or a USART byte in either direction, the only
+    interrupts a wait condition reads the results of.  The firmware is
+    deterministic so the skipped passes would have done nothing too and
+    the run is bit for bit the same as making every pass.
+*/
+
+#define SIM_REGISTER(type, name)    volatile type name;
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+#include "capture.h"
+#include "../../clock.h"
+#include "../../sensors.h"
+#include "../../adc.h"
+#include "../../usart.h"
+#include "../../stack.h"
+#include "../../timer.h"
+
+// Timer0 interrupt period.
+#define AVR_TIMER0_US           10000
+
+// Watchdog timeouts in milliseconds by WDTO_* value.
+static const unsigned avr_wdt_ms[] = { 15, 30, 60, 120, 250, 500, 1000, 2000 };
+
+uint64_t avr_time_us;
+unsigned long avr_wdt_expired;
+unsigned long avr_passes;
+unsigned long avr_edges;
+uint64_t avr_edge_us_max;
+unsigned long avr_skipped;
+capture_t avr_capture;
+
+static uint64_t avr_timer0_due;
+static uint64_t avr_wdt_due;
+static uint8_t avr_wdt_timeout;
+static uint8_t avr_wdt_enabled;
+static double avr_usart_rx_credit;
+static double avr_usart_tx_credit;
+static uint8_t avr_eeprom[512];
+static uint8_t avr_adc_mux;
+static uint16_t avr_adc_value[16];
+static unsigned long avr_wakes;
+static uint8_t avr_ground;
+static uint8_t avr_edge_pending;
+static uint64_t avr_edge_us;
+static uint16_t avr_edge_ocr1a;
+static uint16_t avr_edge_ocr1b;
+static unsigned long avr_idle_wakes;
+static uint8_t avr_idle;
+
+void avr_init(void)
+// Reset the registers and peripherals to their power on state.
+{
+    avr_time_us = 0;
+    avr_wdt_expired = 0;
+    avr_passes = 0;
+    avr_edges = 0;
+    avr_edge_us_max = 0;
+    avr_ground = 0;
+    avr_edge_pending = 0;
+    avr_skipped = 0;
+    avr_wakes = 0;
+    avr_idle = 0;
+    avr_timer0_due = AVR_TIMER0_US;
+    avr_wdt_enabled = 0;
+    avr_usart_rx_credit = 0;
+    avr_usart_tx_credit = 0;
+    avr_adc_mux = 0;
+    memset(avr_adc_value, 0, sizeof(avr_adc_value));
+    memset(avr_eeprom, 0xFF, sizeof(avr_eeprom));
+
+    // Power on reset.
+    MCUSR = (1<<PORF);
+
+    // Inputs float high with the pull-ups and nothing detected.
+    PINB = PINC = PIND = 0xFF;
+
+    // The transmit register is never reported empty so every byte goes
+    // through the data register empty interrupt where it is captured.
+    UCSR0A = 0;
+}
+
+
+void wdt_enable(uint8_t timeout)
+// Start the simulated watchdog.
+{
+    avr_wdt_timeout = timeout & 7;
+    avr_wdt_enabled = 1;
+    wdt_reset();
+}
+
+
+void wdt_disable(void)
+// Stop the simulated watchdog.
+{
+    avr_wdt_enabled = 0;
+}
+
+
+void wdt_reset(void)
+// Restart the simulated watchdog timeout.
+{
+    avr_wdt_due = avr_time_us + 1000ULL * avr_wdt_ms[avr_wdt_timeout];
+}
+
+
+void eeprom_read_block(void* dst, const void* src, size_t n)
+// Read from the simulated EEPROM.
+{
+    memcpy(dst, avr_eeprom + (uintptr_t) src, n);
+}
+
+
+void eeprom_write_block(const void* src, void* dst, size_t n)
+// Write to the simulated EEPROM.
+{
+    memcpy(avr_eeprom + (uintptr_t) dst, src, n);
+}
+
+
+uint16_t stack_unused(void)
+// Stand in for the firmware stack painting, which needs the AVR linker
+// symbols.  The firmware runs on the host stack so none is reported.
+{
+    return 0;
+}
+
+
+static uint8_t avr_pins(uint8_t port, uint8_t pins, uint8_t detected)
+// Return the port pins with the sensors wired to it reflecting the
+// detected sensors.
+{
+#define AVR_SENSOR_PIN(map, sensor)                                             \
+    if (SENSOR_MAP_PORT(map) == port)                                           \
+    {                                                                           \
+        uint8_t level = (detected & (1<<(sensor))) ? SENSOR_MAP_POLARITY(map)   \
+                                                   : !SENSOR_MAP_POLARITY(map); \
+        pins &= ~(1<<SENSOR_MAP_BIT(map));                                      \
+        pins |= (level<<SENSOR_MAP_BIT(map));                                   \
+    }
+
+    AVR_SENSOR_PIN(SENSOR_MAP_LEFT_FRONT, SENSOR_LEFT_FRONT);
+    AVR_SENSOR_PIN(SENSOR_MAP_RIGHT_FRONT, SENSOR_RIGHT_FRONT);
+    AVR_SENSOR_PIN(SENSOR_MAP_GROUND_FRONT, SENSOR_GROUND_FRONT);
+    AVR_SENSOR_PIN(SENSOR_MAP_GROUND_LEFT_FRONT, SENSOR_GROUND_LEFT_FRONT);
+    AVR_SENSOR_PIN(SENSOR_MAP_GROUND_RIGHT_FRONT, SENSOR_GROUND_RIGHT_FRONT);
+    AVR_SENSOR_PIN(SENSOR_MAP_GROUND_LEFT_REAR, SENSOR_GROUND_LEFT_REAR);
+    AVR_SENSOR_PIN(SENSOR_MAP_GROUND_RIGHT_REAR, SENSOR_GROUND_RIGHT_REAR);
+
+#undef AVR_SENSOR_PIN
+
+    return pins;
+}
+
+
+static void avr_capture_input(uint8_t type, uint8_t a, uint8_t b, uint8_t c)
+// Capture an input if a capture is open.
+{
+    uint8_t payload[CAPTURE_PAYLOAD_MAX] = { a, b, c };
+
+    if (avr_capture.file) capture_write(&avr_capture, type, avr_time_us, payload);
+}
+
+
+static void avr_port_input(uint8_t port, uint8_t pins)
+// Drive the input pins of a port and raise its pin change interrupt.
+{
+    uint8_t changed = 0;
+
+    if (port == SENSOR_PORT_B)
+    {
+        if (pins == PINB) return;
+        changed = (pins ^ PINB) & PCMSK0;
+        PINB = pins;
+    }
+    else if (port == SENSOR_PORT_C)
+    {
+        if (pins == PINC) return;
+        changed = (pins ^ PINC) & PCMSK1;
+        PINC = pins;
+    }
+    else if (port == SENSOR_PORT_D)
+    {
+        if (pins == PIND) return;
+        changed = (pins ^ PIND) & PCMSK2;
+        PIND = pins;
+    }
+    else
+    {
+        return;
+    }
+
+    avr_capture_input(CAPTURE_PINS, port, pins, 0);
+
+    if (!changed) return;
+
+    // The firmware only has handlers for ports with sensors.
+#if SENSORS_PORT_MASK(SENSOR_PORT_B)
+    if ((port == SENSOR_PORT_B) && (PCICR & (1<<PCIE0))) SIG_PIN_CHANGE0();
+#endif
+#if SENSORS_PORT_MASK(SENSOR_PORT_C)
+    if ((port == SENSOR_PORT_C) && (PCICR & (1<<PCIE1))) SIG_PIN_CHANGE1();
+#endif
+#if SENSORS_PORT_MASK(SENSOR_PORT_D)
+    if ((port == SENSOR_PORT_D) && (PCICR & (1<<PCIE2))) SIG_PIN_CHANGE2();
+#endif
+}
+
+
+static void avr_adc_input(uint8_t mux, uint16_t value)
+// Set the reading of an analog input.
+{
+    mux &= 0x0F;
+    if (avr_adc_value[mux] == value) return;
+
+    avr_adc_value[mux] = value;
+    avr_capture_input(CAPTURE_ADC, mux, (uint8_t) value, (uint8_t) (value >> 8));
+}
+
+
+static void avr_adc(void)
+// Complete a conversion on the channel latched when it started.  In free
+// running mode the next conversion starts at once with the current ADMUX,
+// so the interrupt handler's write only applies to the one after it.
+{
+    uint8_t mux = avr_adc_mux;
+
+    if (!(ADCSRA & (1<<ADEN)) || !(ADCSRA & (1<<ADIE))) return;
+
+    // Latch the channel for the conversion now starting.
+    avr_adc_mux = ADMUX & 0x0F;
+
+    ADC = avr_adc_value[mux];
+    SIG_ADC();
+}
+
+
+static void avr_rx_input(uint8_t byte, uint8_t errors)
+// Receive a byte on the USART with the given error flags.
+{
+    avr_capture_input(CAPTURE_RX, byte, errors, 0);
+
+    if (!(UCSR0B & (1<<RXEN0))) return;
+
+    UCSR0A |= errors;
+    UDR0 = byte;
+    if (UCSR0B & (1<<RXCIE0))
+    {
+        SIG_USART_RECV();
+        ++avr_wakes;
+    }
+    UCSR0A &= ~errors;
+}
+
+
+static uint32_t avr_usart_baud(void)
+// Return the USART baud rate.
+{
+    return FOSC / (8UL * (UBRR0 + 1));
+}
+
+
+static int avr_tx(uint8_t* byte)
+// Take the next byte the USART transmits in this step.  Returns 0 if
+// there is none.
+{
+    if ((avr_usart_tx_credit < 1.0) || !(UCSR0B & (1<<UDRIE0)))
+    {
+        if (avr_usart_tx_credit > 1.0) avr_usart_tx_credit = 1.0;
+        return 0;
+    }
+
+    avr_usart_tx_credit -= 1.0;
+    SIG_USART_DATA();
+    ++avr_wakes;
+    *byte = UDR0;
+    trace_tx(*byte);
+
+    return 1;
+}
+
+
+static void avr_tick_input(void)
+// Raise the Timer0 compare interrupt.
+{
+    avr_capture_input(CAPTURE_TICK, 0, 0, 0);
+
+    if (TIMSK0 & (1<<OCIE0A))
+    {
+        SIG_OUTPUT_COMPARE0A();
+        ++avr_wakes;
+    }
+}
+
+
+static void avr_watchdog(void)
+// Count watchdog expiries.
+{
+    if (avr_wdt_enabled && (avr_time_us >= avr_wdt_due))
+    {
+        ++avr_wdt_expired;
+        wdt_reset();
+    }
+}
+
+
+static void avr_edge(uint8_t detected)
+// Time the motor response to a ground sensor going over an edge, from the
+// step the sensor goes over to the step the firmware changes the PWM.  A
+// response which never comes, as the motors were already doing the right
+// thing, is given up on after a second.
+{
+    // Note the response to the last edge, which was made in the last step.
+    if (avr_edge_pending && ((OCR1A != avr_edge_ocr1a) || (OCR1B != avr_edge_ocr1b)))
+    {
+        uint64_t us = avr_time_us - SIM_STEP_US - avr_edge_us;
+
+        if (us > avr_edge_us_max) avr_edge_us_max = us;
+        avr_edge_pending = 0;
+    }
+    if (avr_edge_pending && (avr_time_us - avr_edge_us > 1000000)) avr_edge_pending = 0;
+
+    // Start timing a new edge.
+    if ((detected & ~avr_ground) && !avr_edge_pending)
+    {
+        ++avr_edges;
+        avr_edge_pending = 1;
+        avr_edge_us = avr_time_us;
+        avr_edge_ocr1a = OCR1A;
+        avr_edge_ocr1b = OCR1B;
+    }
+    avr_ground = detected;
+}
+
+
+void avr_step(world_t* world)
+// Advance the peripherals by one step with inputs from the world and the
+// camera.
+{
+    double bytes;
+    uint8_t detected;
+    uint8_t byte;
+
+    avr_time_us += SIM_STEP_US;
+    bytes = (double) avr_usart_baud() * SIM_STEP_US / 10e6;
+
+    // The robot moves with the motor PWM.
+    world_step(world, SIM_STEP_US / 1e6, OCR1A, OCR1B);
+
+    // Sample the sensors.
+    detected = world_ground(world);
+    avr_edge(detected);
+    avr_port_input(SENSOR_PORT_B, avr_pins(SENSOR_PORT_B, PINB, detected));
+    avr_port_input(SENSOR_PORT_C, avr_pins(SENSOR_PORT_C, PINC, detected));
+    avr_port_input(SENSOR_PORT_D, avr_pins(SENSOR_PORT_D, PIND, detected));
+    avr_adc_input(ADC_MUX_LEFT_FRONT, world_proximity(world, 0));
+    avr_adc_input(ADC_MUX_RIGHT_FRONT, world_proximity(world, 1));
+    avr_adc_input(ADC_MUX_BATTERY, 736);                    // 7.2 V through the divider.
+    avr_adc();
+
+    // Receive from the camera at the baud rates each is set to.  A
+    // mismatch of more than a few percent garbles the byte.
+    camera_step(world);
+    avr_usart_rx_credit += bytes;
+    while ((avr_usart_rx_credit >= 1.0) && camera_transmit(&byte))
+    {
+        uint32_t baud = avr_usart_baud();
+
+        avr_usart_rx_credit -= 1.0;
+
+        if ((camera_baud() > baud + baud / 25) || (camera_baud() < baud - baud / 25))
+        {
+            avr_rx_input(byte ^ 0x5A, (1<<FE0));
+        }
+        else
+        {
+            avr_rx_input(byte, 0);
+        }
+    }
+    if (avr_usart_rx_credit > 1.0) avr_usart_rx_credit = 1.0;
+
+    // Transmit to the camera.
+    avr_usart_tx_credit += bytes;
+    while (avr_tx(&byte)) camera_receive(byte);
+
+    // Tick the timer.
+    if (avr_time_us >= avr_timer0_due)
+    {
+        avr_timer0_due += AVR_TIMER0_US;
+        avr_tick_input();
+    }
+
+    avr_watchdog();
+}
+
+
+static void avr_replay_phase(int* phase, int next)
+// Carry out the parts of a replayed step between the inputs, in the
+// order avr_step() does them: the conversion after the sensors and the
+// transmit after the received bytes.
+{
+    uint8_t byte;
+
+    if ((*phase < 1) && (next >= 1)) avr_adc();
+    if ((*phase < 2) && (next >= 2)) while (avr_tx(&byte));
+    if (*phase < next) *phase = next;
+}
+
+
+int avr_replay_step(capture_t* capture, capture_record_t* next)
+// Advance the peripherals by one step with the captured inputs due in it.
+// The next record must be read before the first step.  Returns 0 once
+// the capture has ended.
+{
+    int phase = 0;
+
+    if ((next->type == CAPTURE_END) && (avr_time_us + SIM_STEP_US > next->time_us)) return 0;
+
+    avr_time_us += SIM_STEP_US;
+    avr_usart_tx_credit += (double) avr_usart_baud() * SIM_STEP_US / 10e6;
+
+    while ((next->type != CAPTURE_END) && (next->time_us <= avr_time_us))
+    {
+        switch (next->type)
+        {
+            case CAPTURE_PINS:
+                avr_port_input(next->payload[0], next->payload[1]);
+                break;
+            case CAPTURE_ADC:
+                avr_adc_input(next->payload[0], next->payload[1] | (next->payload[2] << 8));
+                break;
+            case CAPTURE_RX:
+                avr_replay_phase(&phase, 1);
+                avr_rx_input(next->payload[0], next->payload[1]);
+                break;
+            case CAPTURE_TICK:
+                avr_replay_phase(&phase, 2);
+                avr_tick_input();
+                break;
+        }
+
+        // A damaged or truncated capture ends here.
+        if (capture_read(capture, next) != 1)
+        {
+            next->type = CAPTURE_END;
+            next->time_us = avr_time_us;
+        }
+    }
+
+    avr_replay_phase(&phase, 2);
+    avr_watchdog();
+
+    return 1;
+}
+
+
+void avr_loop(int event_step)
+// Make a pass of the firmware main loop, or with event stepping skip it
+// if the firmware is still idle.
+{
+    if (event_step && avr_idle && (avr_wakes == avr_idle_wakes))
+    {
+        ++avr_skipped;
+        return;
+    }
+
+    timer_idle_begin();
+    tablebot_loop();
+    ++avr_passes;
+
+    // Note whether this pass did anything and the interrupts so far.
+    avr_idle = timer_idle();
+    avr_idle_wakes = avr_wakes;
+}
@@ -0,0 +1,42 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Simulator stand-in for the avr-libc interrupt definitions.  The
+    simulator runs interrupt handlers between passes of the main loop so
+    they never preempt it and the interrupt enable is not needed.
+*/
+
+#ifndef _SIM_AVR_INTERRUPT_H_
+#define _SIM_AVR_INTERRUPT_H_ 1
+
+#define sei()           ((void) 0)
+#define cli()           ((void) 0)
+
+// Interrupt handlers become functions the simulator calls by name.
+#define SIGNAL(vector)  void vector(void); void vector(void)
+
+#endif // _SIM_AVR_INTERRUPT_H_
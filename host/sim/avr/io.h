@@ -0,0 +1,209 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Simulator stand-in for the avr-libc register definitions.  The
+    registers used by the firmware are plain variables defined in avr.c
+    and read and written by the simulated peripherals.
+*/
+
+#ifndef _SIM_AVR_IO_H_
+#define _SIM_AVR_IO_H_ 1
+
+#include <stdint.h>
+
+#ifndef SIM_REGISTER
+#define SIM_REGISTER(type, name)    extern volatile type name;
+#endif
+
+SIM_REGISTER(uint8_t, PINB)  SIM_REGISTER(uint8_t, DDRB)  SIM_REGISTER(uint8_t, PORTB)
+SIM_REGISTER(uint8_t, PINC)  SIM_REGISTER(uint8_t, DDRC)  SIM_REGISTER(uint8_t, PORTC)
+SIM_REGISTER(uint8_t, PIND)  SIM_REGISTER(uint8_t, DDRD)  SIM_REGISTER(uint8_t, PORTD)
+SIM_REGISTER(uint8_t, MCUCR) SIM_REGISTER(uint8_t, MCUSR) SIM_REGISTER(uint8_t, SREG)
+SIM_REGISTER(uint8_t, TCCR0A) SIM_REGISTER(uint8_t, TCCR0B) SIM_REGISTER(uint8_t, TCNT0)
+SIM_REGISTER(uint8_t, OCR0A) SIM_REGISTER(uint8_t, OCR0B) SIM_REGISTER(uint8_t, TIMSK0) SIM_REGISTER(uint8_t, TIFR0)
+SIM_REGISTER(uint8_t, TCCR1A) SIM_REGISTER(uint8_t, TCCR1B) SIM_REGISTER(uint8_t, TCCR1C)
+SIM_REGISTER(uint16_t, TCNT1) SIM_REGISTER(uint16_t, OCR1A) SIM_REGISTER(uint16_t, OCR1B) SIM_REGISTER(uint16_t, ICR1)
+SIM_REGISTER(uint8_t, TIMSK1) SIM_REGISTER(uint8_t, TIFR1)
+SIM_REGISTER(uint8_t, TCCR2A) SIM_REGISTER(uint8_t, TCCR2B) SIM_REGISTER(uint8_t, TCNT2)
+SIM_REGISTER(uint8_t, OCR2A) SIM_REGISTER(uint8_t, OCR2B) SIM_REGISTER(uint8_t, TIMSK2) SIM_REGISTER(uint8_t, TIFR2)
+SIM_REGISTER(uint16_t, UBRR0) SIM_REGISTER(uint8_t, UCSR0A) SIM_REGISTER(uint8_t, UCSR0B)
+SIM_REGISTER(uint8_t, UCSR0C) SIM_REGISTER(uint8_t, UDR0)
+SIM_REGISTER(uint8_t, PCICR) SIM_REGISTER(uint8_t, PCIFR)
+SIM_REGISTER(uint8_t, PCMSK0) SIM_REGISTER(uint8_t, PCMSK1) SIM_REGISTER(uint8_t, PCMSK2)
+SIM_REGISTER(uint8_t, ADMUX) SIM_REGISTER(uint8_t, ADCSRA) SIM_REGISTER(uint8_t, ADCSRB)
+SIM_REGISTER(uint16_t, ADC) SIM_REGISTER(uint8_t, DIDR0) SIM_REGISTER(uint8_t, WDTCSR)
+
+#define SREG_I 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define DDC0 0
+#define DDC1 1
+#define DDC2 2
+#define DDC3 3
+#define DDD2 2
+#define DDD3 3
+#define DDD4 4
+#define DDD5 5
+#define DDD6 6
+#define DDD7 7
+#define PUD 4
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01 1
+#define WGM00 0
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define OCF0A 1
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define FOC1A 7
+#define FOC1B 6
+#define TOV1 0
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM21 1
+#define WGM20 0
+#define FOC2A 7
+#define FOC2B 6
+#define WGM22 3
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2 0
+#define OCF2A 1
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define MPCM0 0
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define UMSEL01 7
+#define UMSEL00 6
+#define UPM01 5
+#define UPM00 4
+#define USBS0 3
+#define UCSZ01 2
+#define UCSZ00 1
+#define UCPOL0 0
+#define PCIE2 2
+#define PCIE1 1
+#define PCIE0 0
+#define PCIF2 2
+#define PCIF1 1
+#define PCIF0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define RAMEND 0x4FF
+
+#endif // _SIM_AVR_IO_H_
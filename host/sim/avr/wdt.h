@@ -0,0 +1,50 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Simulator stand-in for the avr-libc watchdog definitions.  The
+    simulated watchdog counts expiries instead of resetting the robot.
+*/
+
+#ifndef _SIM_AVR_WDT_H_
+#define _SIM_AVR_WDT_H_ 1
+
+#include <stdint.h>
+
+#define WDTO_15MS       0
+#define WDTO_30MS       1
+#define WDTO_60MS       2
+#define WDTO_120MS      3
+#define WDTO_250MS      4
+#define WDTO_500MS      5
+#define WDTO_1S         6
+#define WDTO_2S         7
+
+void wdt_enable(uint8_t timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#endif // _SIM_AVR_WDT_H_
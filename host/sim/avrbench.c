@@ -0,0 +1,128 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot firmware benchmarks on the AVR.  Runs each case in bench.c
+    and prints the cycles per operation, counted with Timer1 running at
+    the CPU clock, on the USART.  Under simavr the output appears on the
+    console and the run ends when the benchmarks finish.
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "../../clock.h"
+#include "../../usart.h"
+#include "bench.h"
+
+// Operations timed for each case.
+#define AVRBENCH_OPS            16
+
+
+static void avrbench_print(const char* s)
+// Print a string.
+{
+    while (*s) usart_xmit(*s++);
+}
+
+
+static void avrbench_print_uint32(uint32_t value)
+// Print a number.
+{
+    char digits[11];
+    uint8_t i = sizeof(digits) - 1;
+
+    digits[i] = 0;
+    do
+    {
+        digits[--i] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    avrbench_print(digits + i);
+}
+
+
+static uint16_t avrbench_op(const bench_t* bench)
+// Return the cycles one operation takes.
+{
+    uint16_t start;
+    uint16_t end;
+
+    start = TCNT1;
+    bench->op();
+    end = TCNT1;
+
+    return end - start;
+}
+
+
+int main(void)
+{
+    uint32_t cycles;
+    uint16_t overhead;
+    uint8_t i, j;
+
+    bench_init();
+
+    // Count CPU cycles on Timer1 with no interrupts.
+    TCCR1A = 0;
+    TCCR1B = (1<<CS10);
+
+    // Time an empty case for the cost of the timing itself.
+    overhead = 0xFFFF;
+    for (j = 0; j < AVRBENCH_OPS; ++j)
+    {
+        uint16_t start = TCNT1;
+        uint16_t end = TCNT1;
+
+        if ((uint16_t) (end - start) < overhead) overhead = end - start;
+    }
+
+    for (i = 0; i < bench_count; ++i)
+    {
+        // The receive handler returns with interrupts on.
+        cli();
+        benches[i].setup();
+
+        cycles = 0;
+        for (j = 0; j < AVRBENCH_OPS; ++j) cycles += avrbench_op(&benches[i]) - overhead;
+
+        avrbench_print(benches[i].name);
+        avrbench_print(" ");
+        avrbench_print_uint32(cycles / AVRBENCH_OPS);
+        avrbench_print(" cycles\r\n");
+    }
+
+    // Wait for the output and stop, which ends a simavr run.
+    while (!(UCSR0A & (1<<TXC0)));
+    cli();
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_cpu();
+
+    return 0;
+}
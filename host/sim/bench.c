@@ -0,0 +1,254 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot firmware benchmark cases.  Each case drives one of the
+    firmware hot paths with representative or worst case input: packets
+    with one box and with the most boxes, a receive buffer holding one
+    packet and a full one, and sensors which are steady and all toggling.
+    The cases only use the firmware and the AVR registers so they build
+    for the host and for the AVR.
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "../../clock.h"
+#include "../../usart.h"
+#include "../../sensors.h"
+#include "bench.h"
+
+// Firmware functions without a header.
+uint8_t camera_frame(uint8_t byte);
+void camera_frame_reset(void);
+void camera_packet_process(void);
+void SIG_USART_RECV(void);
+
+// Bytes a full receive buffer holds.
+#define BENCH_RING_FULL         63
+
+// Ticks between flips of the sensor inputs, longer than any debounce.
+#define BENCH_SENSORS_FLIP      16
+
+// Tracking packets with one box and with the most boxes of several colors.
+static const uint8_t bench_packet_1[] = { 0x0A, 1, 0, 70, 50, 100, 80, 0xFF };
+static const uint8_t bench_packet_8[] =
+{
+    0x0A, 8,
+    0, 70, 50, 100, 80,
+    1, 4, 4, 14, 14,
+    2, 24, 4, 60, 30,
+    3, 44, 4, 54, 14,
+    4, 64, 4, 74, 14,
+    5, 84, 100, 120, 140,
+    6, 104, 4, 114, 14,
+    7, 124, 4, 175, 143,
+    0xFF
+};
+
+static uint8_t bench_sensors_ticks;
+static uint8_t bench_sensors_flip;
+
+
+static void bench_frame(const uint8_t* packet, uint8_t length)
+// Frame a packet.
+{
+    uint8_t i;
+
+    for (i = 0; i < length; ++i) camera_frame(packet[i]);
+}
+
+
+static void bench_rx(const uint8_t* data, uint8_t length)
+// Receive bytes through the USART interrupt handler.
+{
+    uint8_t i;
+
+    for (i = 0; i < length; ++i)
+    {
+        // The AVR handler reads whatever the USART holds.
+#ifndef __AVR__
+        UDR0 = data[i];
+#endif
+        SIG_USART_RECV();
+    }
+}
+
+
+static void bench_rx_full(void)
+// Fill the receive buffer with bytes which are not an eol.
+{
+    uint8_t data[BENCH_RING_FULL];
+    uint8_t i;
+
+    for (i = 0; i < BENCH_RING_FULL; ++i) data[i] = i;
+    usart_recv_flush();
+    bench_rx(data, BENCH_RING_FULL);
+}
+
+
+static void bench_none(void)
+// No setup.
+{
+}
+
+
+static void bench_frame_setup(void)
+// Start framing on a packet boundary.
+{
+    camera_frame_reset();
+}
+
+
+static void bench_frame_8(void)
+// Frame a packet with the most boxes.
+{
+    bench_frame(bench_packet_8, sizeof(bench_packet_8));
+}
+
+
+static void bench_process_1_setup(void)
+// Frame a packet with one box.
+{
+    camera_frame_reset();
+    bench_frame(bench_packet_1, sizeof(bench_packet_1));
+}
+
+
+static void bench_process_8_setup(void)
+// Frame a packet with the most boxes.
+{
+    camera_frame_reset();
+    bench_frame(bench_packet_8, sizeof(bench_packet_8));
+}
+
+
+static void bench_process(void)
+// Process the framed packet.
+{
+    camera_packet_process();
+}
+
+
+static void bench_eol_packet_setup(void)
+// Receive a packet with the most boxes.
+{
+    usart_recv_flush();
+    bench_rx(bench_packet_8, sizeof(bench_packet_8));
+}
+
+
+static void bench_eol(void)
+// Look for the packet trailer.
+{
+    usart_recv_buffer_has_eol(0xFF);
+}
+
+
+static void bench_rx_fill(void)
+// Fill the receive buffer and empty it again.
+{
+    usart_recv_flush();
+    bench_rx_full();
+}
+
+
+static void bench_rx_read(void)
+// Fill the receive buffer and read it out in the chunks the camera
+// packet reader uses.
+{
+    char buffer[16];
+
+    bench_rx_full();
+    while (usart_recv_buffer(buffer, sizeof(buffer), 0xFF));
+}
+
+
+static void bench_sensors_set(uint8_t b, uint8_t c, uint8_t d)
+// Set the sensor inputs.  The AVR drives the sensor pins so they read
+// back what is written.
+{
+#ifdef __AVR__
+    DDRB |= SENSORS_PORT_MASK(SENSOR_PORT_B);
+    DDRC |= SENSORS_PORT_MASK(SENSOR_PORT_C);
+    DDRD |= SENSORS_PORT_MASK(SENSOR_PORT_D);
+    PORTB = (PORTB & ~SENSORS_PORT_MASK(SENSOR_PORT_B)) | (b & SENSORS_PORT_MASK(SENSOR_PORT_B));
+    PORTC = (PORTC & ~SENSORS_PORT_MASK(SENSOR_PORT_C)) | (c & SENSORS_PORT_MASK(SENSOR_PORT_C));
+    PORTD = (PORTD & ~SENSORS_PORT_MASK(SENSOR_PORT_D)) | (d & SENSORS_PORT_MASK(SENSOR_PORT_D));
+#else
+    PINB = b;
+    PINC = c;
+    PIND = d;
+#endif
+}
+
+
+static void bench_sensors_setup(void)
+// Start the sensors from idle inputs.
+{
+    sensors_init();
+    bench_sensors_flip = 0x00;
+    bench_sensors_set(0x00, 0x00, 0x00);
+    bench_sensors_ticks = 0;
+}
+
+
+static void bench_sensors_toggle(void)
+// Update the sensors, flipping every input often enough for each to
+// toggle once a flip.
+{
+    if (++bench_sensors_ticks >= BENCH_SENSORS_FLIP)
+    {
+        bench_sensors_ticks = 0;
+        bench_sensors_flip = ~bench_sensors_flip;
+        bench_sensors_set(bench_sensors_flip, bench_sensors_flip, bench_sensors_flip);
+    }
+
+    sensors_update();
+}
+
+
+const bench_t benches[] =
+{
+    { "camera_frame 8 boxes", bench_frame_setup, bench_frame_8 },
+    { "camera_packet_process 1 box", bench_process_1_setup, bench_process },
+    { "camera_packet_process 8 boxes", bench_process_8_setup, bench_process },
+    { "usart_recv_buffer_has_eol packet", bench_eol_packet_setup, bench_eol },
+    { "usart_recv_buffer_has_eol full", bench_rx_full, bench_eol },
+    { "rx interrupt x63", bench_none, bench_rx_fill },
+    { "rx interrupt x63 + usart_recv_buffer", bench_none, bench_rx_read },
+    { "sensors_update steady", bench_sensors_setup, sensors_update },
+    { "sensors_update toggling", bench_sensors_setup, bench_sensors_toggle },
+};
+
+const uint8_t bench_count = sizeof(benches) / sizeof(benches[0]);
+
+
+void bench_init(void)
+// Initialize the firmware modules the cases use.
+{
+    sensors_init();
+    usart_init(USART_UBRR(USART_BAUD));
+}
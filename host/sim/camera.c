@@ -0,0 +1,342 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Synthetic camera.  Answers the AVRcam style commands and, while
+    tracking, streams a 0x0A ... 0xFF bounding box packet per frame for
+    the blocks in its field of view in a 176x144 image.
+
+    For stress testing the camera can also pad packets with extra boxes,
+    jitter the frames, hold frames to send them in bursts, corrupt bytes,
+    send garbage between packets and delay its replies.  Bytes leave at
+    the line rate through a queue standing in for the camera's transmit
+    buffer, and bytes which do not fit are counted and lost.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "sim.h"
+#include "../../clock.h"
+#include "../../usart.h"
+
+// Image size.
+#define CAMERA_WIDTH            176
+#define CAMERA_HEIGHT           144
+
+// Camera position ahead of the robot center and its horizontal half
+// field of view.  The camera looks down so near objects are lower in
+// the image, from the bottom at CAMERA_NEAR to near the top at CAMERA_FAR.
+#define CAMERA_OFFSET           0.05
+#define CAMERA_HALF_FOV         0.45
+#define CAMERA_NEAR             0.04
+#define CAMERA_FAR              1.20
+
+// Most boxes in a packet and the color of the extra boxes, which is not
+// one the firmware looks for.
+#define CAMERA_MAX_BOXES        8
+#define CAMERA_EXTRA_COLOR      1
+
+// Transmit queue, burst hold buffer and replies waiting on their delay.
+#define CAMERA_QUEUE_SIZE       4096
+#define CAMERA_HOLD_SIZE        2048
+#define CAMERA_REPLIES          8
+
+unsigned long camera_packets;
+unsigned long camera_overflows;
+
+static camera_config_t camera_config;
+static uint8_t camera_queue[CAMERA_QUEUE_SIZE];
+static unsigned camera_queue_head;
+static unsigned camera_queue_tail;
+static uint8_t camera_hold[CAMERA_HOLD_SIZE];
+static unsigned camera_hold_length;
+static unsigned camera_hold_frames;
+static struct
+{
+    uint64_t due_us;
+    const char* text;
+} camera_replies[CAMERA_REPLIES];
+static unsigned camera_reply_count;
+static char camera_line[16];
+static unsigned camera_line_len;
+static int camera_tracking;
+static uint64_t camera_frame_base;
+static uint64_t camera_frame_due;
+static uint32_t camera_seed;
+
+void camera_init(const camera_config_t* config, unsigned long seed)
+// Power up the camera.  It ignores commands until it has booted.
+{
+    camera_config = *config;
+    if (!camera_config.fps) camera_config.fps = 30;
+    if (!camera_config.burst) camera_config.burst = 1;
+
+    camera_packets = 0;
+    camera_overflows = 0;
+    camera_queue_head = camera_queue_tail = 0;
+    camera_hold_length = 0;
+    camera_hold_frames = 0;
+    camera_reply_count = 0;
+    camera_line_len = 0;
+    camera_tracking = 0;
+    camera_frame_base = camera_frame_due = 0;
+    camera_seed = (uint32_t) seed | 1;
+}
+
+
+uint32_t camera_baud(void)
+// Return the camera baud rate.
+{
+    return USART_BAUD;
+}
+
+
+static uint64_t camera_period_us(void)
+// Return the time between frames.
+{
+    return 1000000 / camera_config.fps;
+}
+
+
+static void camera_put(uint8_t byte)
+// Queue a byte for the robot, corrupting it at the configured rate.
+// Bytes are lost if the queue is full.
+{
+    unsigned next = (camera_queue_tail + 1) % CAMERA_QUEUE_SIZE;
+
+    if (next == camera_queue_head)
+    {
+        ++camera_overflows;
+        return;
+    }
+
+    if (camera_config.corrupt_permille && ((sim_random(&camera_seed) % 1000) < camera_config.corrupt_permille))
+    {
+        byte ^= 1 << (sim_random(&camera_seed) % 8);
+    }
+
+    camera_queue[camera_queue_tail] = byte;
+    camera_queue_tail = next;
+}
+
+
+static void camera_puts(const char* s)
+// Queue a reply for the robot.
+{
+    while (*s) camera_put((uint8_t) *s++);
+}
+
+
+static void camera_frame_put(uint8_t byte)
+// Queue a frame byte, holding it back while a burst is collected.
+{
+    if (camera_config.burst <= 1) camera_put(byte);
+    else if (camera_hold_length < CAMERA_HOLD_SIZE) camera_hold[camera_hold_length++] = byte;
+    else ++camera_overflows;
+}
+
+
+int camera_transmit(uint8_t* byte)
+// Take the next byte for the robot.  Returns 0 if there is none.
+{
+    if (camera_queue_head == camera_queue_tail) return 0;
+
+    *byte = camera_queue[camera_queue_head];
+    camera_queue_head = (camera_queue_head + 1) % CAMERA_QUEUE_SIZE;
+
+    return 1;
+}
+
+
+static void camera_reply(const char* text)
+// Send a reply now or after the configured delay.
+{
+    if (!camera_config.ack_ms)
+    {
+        camera_puts(text);
+        return;
+    }
+
+    if (camera_reply_count >= CAMERA_REPLIES) return;
+
+    camera_replies[camera_reply_count].due_us = avr_time_us + 1000ULL * camera_config.ack_ms;
+    camera_replies[camera_reply_count].text = text;
+    ++camera_reply_count;
+}
+
+
+static void camera_command(const char* command)
+// Answer a command.
+{
+    if (!strcmp(command, "PG"))
+    {
+        camera_reply("ACK\r");
+    }
+    else if (!strcmp(command, "DT"))
+    {
+        camera_tracking = 0;
+        camera_reply("ACK\r");
+    }
+    else if (!strcmp(command, "ET"))
+    {
+        camera_tracking = 1;
+        camera_frame_base = camera_frame_due = avr_time_us + camera_period_us();
+        camera_reply("ACK\r");
+    }
+    else
+    {
+        camera_reply("NCK\r");
+    }
+}
+
+
+void camera_receive(uint8_t byte)
+// Take a byte from the robot.
+{
+    // Nothing is heard until the camera has booted.
+    if (avr_time_us < 1000ULL * camera_config.boot_ms) return;
+
+    if (byte == '\r')
+    {
+        camera_line[camera_line_len] = 0;
+        camera_command(camera_line);
+        camera_line_len = 0;
+    }
+    else if (camera_line_len < sizeof(camera_line) - 1)
+    {
+        camera_line[camera_line_len++] = (char) byte;
+    }
+}
+
+
+static uint8_t camera_clip(double value, int limit)
+// Clip an image coordinate.
+{
+    if (value < 0) return 0;
+    if (value > limit - 1) return (uint8_t) (limit - 1);
+    return (uint8_t) value;
+}
+
+
+void camera_step(const world_t* world)
+// Send the replies which are due and stream a tracking packet each frame
+// while tracking.
+{
+    uint8_t boxes[CAMERA_MAX_BOXES][5];
+    int count = 0;
+    int i;
+    double cx, cy;
+
+    // Send the replies which are due in order.
+    while (camera_reply_count && (avr_time_us >= camera_replies[0].due_us))
+    {
+        camera_puts(camera_replies[0].text);
+        memmove(&camera_replies[0], &camera_replies[1], --camera_reply_count * sizeof(camera_replies[0]));
+    }
+
+    if (!camera_tracking || (avr_time_us < camera_frame_due)) return;
+
+    // Schedule the next frame from the steady frame clock.
+    camera_frame_base += camera_period_us();
+    camera_frame_due = camera_frame_base;
+    if (camera_config.jitter_us) camera_frame_due += sim_random(&camera_seed) % (camera_config.jitter_us + 1);
+
+    // Drop frames.
+    if (camera_config.drop_percent && ((sim_random(&camera_seed) % 100) < camera_config.drop_percent)) return;
+
+    cx = world->x + CAMERA_OFFSET * cos(world->heading);
+    cy = world->y + CAMERA_OFFSET * sin(world->heading);
+
+    // Project each block in view.
+    for (i = 0; (i < world->block_count) && (count < CAMERA_MAX_BOXES); ++i)
+    {
+        const world_block_t* block = &world->blocks[i];
+        double dx = block->x - cx;
+        double dy = block->y - cy;
+        double d = hypot(dx, dy);
+        double angle = remainder(atan2(dy, dx) - world->heading, 2 * M_PI);
+        double half, x, y;
+
+        if (!block->on_table || (d < CAMERA_NEAR) || (d > CAMERA_FAR)) continue;
+
+        // Angular half size of the block in pixels.
+        half = atan(block->r / d) / CAMERA_HALF_FOV * (CAMERA_WIDTH / 2);
+        if (fabs(angle) > CAMERA_HALF_FOV + atan(block->r / d)) continue;
+
+        // Objects to the left appear on the left of the image.
+        x = (CAMERA_WIDTH / 2) - angle / CAMERA_HALF_FOV * (CAMERA_WIDTH / 2);
+        y = (CAMERA_HEIGHT - 1) - (d - CAMERA_NEAR) / (CAMERA_FAR - CAMERA_NEAR) * (CAMERA_HEIGHT - 20);
+
+        boxes[count][0] = block->color;
+        boxes[count][1] = camera_clip(x - half, CAMERA_WIDTH);
+        boxes[count][2] = camera_clip(y - half * 0.8, CAMERA_HEIGHT);
+        boxes[count][3] = camera_clip(x + half, CAMERA_WIDTH);
+        boxes[count][4] = camera_clip(y + half * 0.8, CAMERA_HEIGHT);
+        ++count;
+    }
+
+    // Pad with extra boxes spread along the top of the image.
+    for (i = 0; (i < (int) camera_config.boxes) && (count < CAMERA_MAX_BOXES); ++i)
+    {
+        boxes[count][0] = CAMERA_EXTRA_COLOR;
+        boxes[count][1] = (uint8_t) (4 + 20 * i);
+        boxes[count][2] = 4;
+        boxes[count][3] = (uint8_t) (14 + 20 * i);
+        boxes[count][4] = 14;
+        ++count;
+    }
+
+    // Send garbage ahead of the packet.
+    if (camera_config.garbage_permille && ((sim_random(&camera_seed) % 1000) < camera_config.garbage_permille))
+    {
+        int garbage = 1 + sim_random(&camera_seed) % 8;
+
+        for (i = 0; i < garbage; ++i) camera_frame_put((uint8_t) sim_random(&camera_seed));
+    }
+
+    // Send the packet.
+    camera_frame_put(0x0A);
+    camera_frame_put((uint8_t) count);
+    for (i = 0; i < count; ++i)
+    {
+        camera_frame_put(boxes[i][0]);
+        camera_frame_put(boxes[i][1]);
+        camera_frame_put(boxes[i][2]);
+        camera_frame_put(boxes[i][3]);
+        camera_frame_put(boxes[i][4]);
+    }
+    camera_frame_put(0xFF);
+
+    ++camera_packets;
+
+    // Release a complete burst.
+    if ((camera_config.burst > 1) && (++camera_hold_frames >= camera_config.burst))
+    {
+        for (i = 0; i < (int) camera_hold_length; ++i) camera_put(camera_hold[i]);
+        camera_hold_length = 0;
+        camera_hold_frames = 0;
+    }
+}
@@ -0,0 +1,150 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Input capture files.  See capture.h for the layout.
+*/
+
+#include <string.h>
+#include "capture.h"
+
+// Payload size by record type.
+static const uint8_t capture_payload_size[] =
+{
+    [CAPTURE_END]   = 0,
+    [CAPTURE_TICK]  = 0,
+    [CAPTURE_PINS]  = 2,
+    [CAPTURE_ADC]   = 3,
+    [CAPTURE_RX]    = 2,
+};
+
+#define CAPTURE_TYPES   (sizeof(capture_payload_size) / sizeof(capture_payload_size[0]))
+
+int capture_create(capture_t* capture, const char* path)
+// Create a capture file.  Returns 0 on success.
+{
+    capture->file = fopen(path, "wb");
+    capture->time_us = 0;
+    capture->records = 0;
+
+    if (!capture->file) return -1;
+
+    fwrite(CAPTURE_MAGIC, 1, 4, capture->file);
+    fputc(CAPTURE_VERSION, capture->file);
+
+    return 0;
+}
+
+
+void capture_write(capture_t* capture, uint8_t type, uint64_t time_us, const uint8_t* payload)
+// Append a record.
+{
+    uint64_t delta = time_us - capture->time_us;
+
+    fputc(type, capture->file);
+    do
+    {
+        fputc((delta & 0x7F) | ((delta > 0x7F) ? 0x80 : 0), capture->file);
+        delta >>= 7;
+    }
+    while (delta);
+    if (capture_payload_size[type]) fwrite(payload, 1, capture_payload_size[type], capture->file);
+
+    capture->time_us = time_us;
+    ++capture->records;
+}
+
+
+int capture_close(capture_t* capture, uint64_t time_us)
+// End a capture being written at the time given, or one being read.
+// Returns 0 on success.
+{
+    int error = 0;
+
+    if (!capture->file) return -1;
+
+    if (time_us) capture_write(capture, CAPTURE_END, time_us, NULL);
+    if (ferror(capture->file)) error = -1;
+    if (fclose(capture->file)) error = -1;
+    capture->file = NULL;
+
+    return error;
+}
+
+
+int capture_open(capture_t* capture, const char* path)
+// Open a capture file to read.  Returns 0 on success.
+{
+    char magic[5];
+
+    capture->file = fopen(path, "rb");
+    capture->time_us = 0;
+    capture->records = 0;
+
+    if (!capture->file) return -1;
+
+    if ((fread(magic, 1, 5, capture->file) != 5) ||
+        memcmp(magic, CAPTURE_MAGIC, 4) || (magic[4] != CAPTURE_VERSION))
+    {
+        fclose(capture->file);
+        capture->file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int capture_read(capture_t* capture, capture_record_t* record)
+// Read the next record.  Returns 1 for a record, 0 at the end of the file
+// and -1 if it is damaged.  A truncated file ends at its last whole record.
+{
+    uint64_t delta = 0;
+    int shift = 0;
+    int c;
+
+    c = fgetc(capture->file);
+    if (c == EOF) return 0;
+    if (c >= (int) CAPTURE_TYPES) return -1;
+    record->type = (uint8_t) c;
+
+    do
+    {
+        c = fgetc(capture->file);
+        if ((c == EOF) || (shift > 56)) return 0;
+        delta |= (uint64_t) (c & 0x7F) << shift;
+        shift += 7;
+    }
+    while (c & 0x80);
+
+    if (fread(record->payload, 1, capture_payload_size[record->type], capture->file) != capture_payload_size[record->type]) return 0;
+
+    capture->time_us += delta;
+    record->time_us = capture->time_us;
+    ++capture->records;
+
+    return 1;
+}
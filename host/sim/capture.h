@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Input captures.  A capture holds every input the firmware saw with
+    its time so a run can be replayed exactly without the world or the
+    camera.  The file starts with CAPTURE_MAGIC and CAPTURE_VERSION and
+    is followed by records of a type byte, the microseconds since the
+    previous record as an unsigned LEB128 number and a payload whose size
+    is set by the type.  The last record is CAPTURE_END.
+*/
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_ 1
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define CAPTURE_MAGIC           "TBCP"
+#define CAPTURE_VERSION         1
+
+// Record types and payloads.
+#define CAPTURE_END             0           // End of the run.
+#define CAPTURE_TICK            1           // Timer0 compare.
+#define CAPTURE_PINS            2           // SENSOR_PORT_B to SENSOR_PORT_D, pin levels.
+#define CAPTURE_ADC             3           // Channel mux, 16-bit reading little endian.
+                                            // Conversions return it from now on.
+#define CAPTURE_RX              4           // USART byte, UCSR0A error flags.
+
+#define CAPTURE_PAYLOAD_MAX     3
+
+typedef struct
+{
+    uint8_t type;
+    uint64_t time_us;
+    uint8_t payload[CAPTURE_PAYLOAD_MAX];
+} capture_record_t;
+
+typedef struct
+{
+    FILE* file;
+    uint64_t time_us;                       // Time of the last record.
+    unsigned long records;
+} capture_t;
+
+int capture_create(capture_t* capture, const char* path);
+void capture_write(capture_t* capture, uint8_t type, uint64_t time_us, const uint8_t* payload);
+int capture_close(capture_t* capture, uint64_t time_us);
+int capture_open(capture_t* capture, const char* path);
+int capture_read(capture_t* capture, capture_record_t* record);
+
+#endif // _CAPTURE_H_
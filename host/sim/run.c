@@ -0,0 +1,257 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Simulator runs.  Holds the standard scenarios and runs one from power
+    on with the given options and tunables.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/wait.h>
+#include <avr/io.h>
+#include "sim.h"
+#include "../../clock.h"
+#include "../../motors.h"
+#include "../../usart.h"
+
+int16_t tune_value[TUNE_COUNT];
+uint8_t tune_set[TUNE_COUNT];
+
+const char* const tune_names[TUNE_COUNT] =
+{
+    [TUNE_CRUISE_PWM]       = "cruise_pwm",
+    [TUNE_ROTATE_TIME]      = "rotate_time",
+    [TUNE_TURNAWAY_TIME]    = "turnaway_time",
+    [TUNE_SEARCH_TIME]      = "search_time",
+    [TUNE_SEARCH_STEP]      = "search_step",
+    [TUNE_DEADBAND]         = "deadband",
+};
+
+static void scenario_single(world_t* world)
+{
+    world_init(world, 1.0, 0.6, 0.2, 0.3, 0.0);
+    world_add_block(world, 0.6, 0.3, WORLD_RED);
+}
+
+static void scenario_offset(world_t* world)
+{
+    world_init(world, 1.0, 0.6, 0.2, 0.15, 0.5);
+    world_add_block(world, 0.7, 0.42, WORLD_RED);
+}
+
+static void scenario_behind(world_t* world)
+{
+    world_init(world, 1.0, 0.6, 0.6, 0.3, 0.0);
+    world_add_block(world, 0.3, 0.3, WORLD_RED);
+}
+
+static void scenario_scatter(world_t* world)
+{
+    world_init(world, 1.2, 0.8, 0.6, 0.4, 1.0);
+    world_add_block(world, 0.3, 0.2, WORLD_RED);
+    world_add_block(world, 0.9, 0.6, WORLD_RED);
+    world_add_block(world, 0.4, 0.65, WORLD_RED);
+}
+
+static void scenario_marker(world_t* world)
+{
+    world_init(world, 1.0, 0.6, 0.2, 0.3, 0.0);
+    world_add_block(world, 0.75, 0.3, WORLD_RED);
+    world_add_block(world, 0.45, 0.22, WORLD_BLUE);
+}
+
+static void scenario_obstacle(world_t* world)
+{
+    world_init(world, 1.2, 0.6, 0.2, 0.3, 0.0);
+    world_add_obstacle(world, 0.55, 0.3, 0.05);
+    world_add_block(world, 0.9, 0.3, WORLD_RED);
+}
+
+static void scenario_edge(world_t* world)
+{
+    world_init(world, 0.6, 0.6, 0.3, 0.3, 0.8);
+}
+
+const scenario_t scenarios[] =
+{
+    { "single",   "one block straight ahead",           scenario_single },
+    { "offset",   "one block off to the side",          scenario_offset },
+    { "behind",   "one block behind the robot",         scenario_behind },
+    { "scatter",  "three blocks around the robot",      scenario_scatter },
+    { "marker",   "a block behind a blue marker",       scenario_marker },
+    { "obstacle", "a block behind a fixed obstacle",    scenario_obstacle },
+    { "edge",     "an empty table to wander",           scenario_edge },
+};
+
+const int scenario_count = sizeof(scenarios) / sizeof(scenarios[0]);
+
+uint32_t sim_random(uint32_t* seed)
+// Return the next number from a small xorshift generator.
+{
+    uint32_t x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *seed = x;
+}
+
+
+int sim_run(const scenario_t* scenario, const sim_options_t* options, sim_result_t* result)
+// Run a scenario from power on.  Returns 0 on success.
+{
+    world_t* world = &result->world;
+    uint64_t end_us = (uint64_t) (options->seconds * 1e6);
+    uint64_t report_us = 0;
+    uint64_t loop_us = 0;
+    int error = 0;
+    uint32_t seed = (uint32_t) options->seed;
+
+    memset(result, 0, sizeof(*result));
+
+    // Set up the world with some noise in the start pose.
+    scenario->setup(world);
+    if (seed)
+    {
+        world->x += ((int) (sim_random(&seed) % 21) - 10) / 1000.0;
+        world->y += ((int) (sim_random(&seed) % 21) - 10) / 1000.0;
+        world->heading += ((int) (sim_random(&seed) % 21) - 10) / 100.0;
+        world->start_x = world->x;
+        world->start_y = world->y;
+        world->start_heading = world->heading;
+    }
+    result->blocks = world_remaining(world);
+
+    // Apply the tunables.
+    memcpy(tune_value, options->tune_value, sizeof(tune_value));
+    memcpy(tune_set, options->tune_set, sizeof(tune_set));
+
+    // Power on.
+    avr_init();
+    camera_init(&options->camera, options->seed);
+    trace_packets = 0;
+
+    // Capture the inputs and trace the outputs from the start.
+    if (options->capture_path && capture_create(&avr_capture, options->capture_path))
+    {
+        perror(options->capture_path);
+        return -1;
+    }
+    if (options->trace_path && !(trace_file = fopen(options->trace_path, "w")))
+    {
+        perror(options->trace_path);
+        return -1;
+    }
+
+    tablebot_init();
+
+    // Run until the table is clear or the time is up.
+    while (avr_time_us < end_us)
+    {
+        avr_step(world);
+
+        // The main loop makes a pass each time the last one would end.
+        if (avr_time_us >= loop_us)
+        {
+            loop_us += options->loop_us;
+            avr_loop(options->event_step);
+        }
+
+        if (result->blocks && !world_remaining(world)) break;
+
+        if (options->verbose && (avr_time_us >= report_us))
+        {
+            report_us += 1000000;
+            printf("%6.1f s  x %5.3f y %5.3f heading %6.1f  pwm %4d %4d  remaining %d  falls %d\n",
+                   avr_time_us / 1e6, world->x, world->y, world->heading * 180 / M_PI,
+                   (int) OCR1A - MOTORS_IDLE_PWM, (int) OCR1B - MOTORS_IDLE_PWM,
+                   world_remaining(world), world->falls);
+        }
+    }
+
+    result->seconds = avr_time_us / 1e6;
+    result->packets = camera_packets;
+    result->wdt_expired = avr_wdt_expired;
+    result->processed = trace_packets;
+    result->recv_overflows = usart_recv_overflows();
+    result->recv_errors = usart_recv_errors();
+    result->camera_overflows = camera_overflows;
+    result->passes = avr_passes;
+    result->skipped = avr_skipped;
+    result->edges = avr_edges;
+    result->edge_ms = avr_edge_us_max / 1e3;
+
+    if (options->verbose && avr_edges)
+    {
+        printf("edges %lu  longest edge to pwm %.1f ms\n", avr_edges, result->edge_ms);
+    }
+
+    if (avr_capture.file && capture_close(&avr_capture, avr_time_us)) error = -1;
+    if (trace_file && fclose(trace_file)) error = -1;
+    trace_file = NULL;
+
+    return error;
+}
+
+
+int sim_run_process(const scenario_t* scenario, const sim_options_t* options, sim_result_t* result)
+// Run a scenario in a child process so the firmware starts from reset.
+// Returns 0 on success.
+{
+    int fds[2];
+    pid_t pid;
+    ssize_t n;
+    int status;
+
+    if (pipe(fds)) return -1;
+
+    // Write out anything buffered so the child does not print it again.
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) return -1;
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (sim_run(scenario, options, result)) _exit(1);
+        n = write(fds[1], result, sizeof(*result));
+        fflush(stdout);
+        _exit(n == sizeof(*result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    n = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return ((n == sizeof(*result)) && WIFEXITED(status) && !WEXITSTATUS(status)) ? 0 : -1;
+}
+
+
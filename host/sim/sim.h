@@ -0,0 +1,205 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot simulator.  Runs the unmodified firmware against simulated
+    AVR peripherals, a tabletop world and a synthetic camera in virtual
+    time.
+*/
+
+#ifndef _SIM_H_
+#define _SIM_H_ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tune.h"
+#include "capture.h"
+
+// Virtual time step.  The main loop makes one pass per step.
+#define SIM_STEP_US             100
+
+// Table, robot and block limits.
+#define WORLD_BLOCKS            8
+#define WORLD_OBSTACLES         4
+
+// Block colors as camera color indexes.
+#define WORLD_RED               0
+#define WORLD_BLUE              2
+
+typedef struct
+{
+    double x, y;                // Position of the center in meters.
+    double r;                   // Radius in meters.
+    uint8_t color;              // Camera color index.
+    uint8_t on_table;           // Cleared once it falls off.
+} world_block_t;
+
+typedef struct
+{
+    double x, y;                // Position of the center in meters.
+    double r;                   // Radius in meters.
+} world_obstacle_t;
+
+typedef struct
+{
+    // Table size in meters with a corner at the origin.
+    double width, height;
+
+    // Robot pose and wheel speeds in meters per second.
+    double x, y, heading;
+    double start_x, start_y, start_heading;
+    double left, right;
+
+    // Objects on the table.
+    world_block_t blocks[WORLD_BLOCKS];
+    int block_count;
+    world_obstacle_t obstacles[WORLD_OBSTACLES];
+    int obstacle_count;
+
+    // Metrics.
+    double distance;            // Meters driven.
+    double clear_time;          // Seconds until the last red block fell, or -1.
+    int falls;                  // Times the robot drove off the table.
+    int cleared;                // Red blocks pushed off the table.
+    int markers_lost;           // Other blocks pushed off the table.
+} world_t;
+
+typedef struct
+{
+    const char* name;
+    const char* description;
+    void (*setup)(world_t* world);
+} scenario_t;
+
+typedef struct
+{
+    unsigned boot_ms;           // Commands are ignored until booted.
+    unsigned fps;               // Tracking packets per second.
+    unsigned boxes;             // Extra boxes in each packet.
+    unsigned jitter_us;         // Largest random delay of each frame.
+    unsigned burst;             // Frames held and sent back to back.
+    unsigned drop_percent;      // Frames dropped.
+    unsigned corrupt_permille;  // Bytes with a bit flipped.
+    unsigned garbage_permille;  // Packets preceded by random bytes.
+    unsigned ack_ms;            // Delay before each reply.
+} camera_config_t;
+
+#define CAMERA_CONFIG_DEFAULT   { .boot_ms = 250, .fps = 30, .burst = 1 }
+
+typedef struct
+{
+    double seconds;             // Virtual time limit.
+    unsigned long seed;         // Start pose noise, none if zero.
+    camera_config_t camera;
+    unsigned loop_us;           // Time the firmware takes for each pass of
+                                // its main loop, at least SIM_STEP_US.
+    int event_step;             // Skip the main loop passes while it is idle.
+    int verbose;
+    const char* capture_path;   // Capture the inputs to this file.
+    const char* trace_path;     // Trace the outputs to this file.
+    int16_t tune_value[TUNE_COUNT];     // Tunables overriding the firmware
+    uint8_t tune_set[TUNE_COUNT];       // defaults where set.
+} sim_options_t;
+
+typedef struct
+{
+    world_t world;
+    double seconds;             // Virtual time run.
+    unsigned long packets;      // Camera packets sent.
+    unsigned long wdt_expired;  // Watchdog expiries.
+    unsigned long processed;    // Camera packets processed by the firmware.
+    unsigned recv_overflows;    // Bytes lost from the firmware receive buffer.
+    unsigned recv_errors;       // Framing errors and data overruns.
+    unsigned long camera_overflows; // Bytes the camera could not queue for the line.
+    unsigned long passes;       // Main loop passes made.
+    unsigned long skipped;      // Idle main loop passes skipped.
+    unsigned long edges;        // Ground sensors going over an edge.
+    double edge_ms;             // Longest from an edge to the motor PWM changing.
+    int blocks;                 // Red blocks at the start.
+} sim_result_t;
+
+#define SIM_OPTIONS_DEFAULT     { .seconds = 120.0, .camera = CAMERA_CONFIG_DEFAULT, .loop_us = SIM_STEP_US }
+
+// Firmware entry points from main.c.
+void tablebot_init(void);
+void tablebot_loop(void);
+
+// Firmware interrupt handlers.
+void SIG_OUTPUT_COMPARE0A(void);
+void SIG_OUTPUT_COMPARE2A(void);
+void SIG_USART_RECV(void);
+void SIG_USART_DATA(void);
+void SIG_PIN_CHANGE0(void);
+void SIG_PIN_CHANGE1(void);
+void SIG_PIN_CHANGE2(void);
+void SIG_ADC(void);
+
+// Simulated AVR peripherals.
+extern uint64_t avr_time_us;
+extern unsigned long avr_wdt_expired;
+extern unsigned long avr_passes;
+extern unsigned long avr_edges;
+extern uint64_t avr_edge_us_max;
+extern unsigned long avr_skipped;
+extern capture_t avr_capture;
+void avr_init(void);
+void avr_step(world_t* world);
+int avr_replay_step(capture_t* capture, capture_record_t* next);
+void avr_loop(int event_step);
+
+// Output traces.
+extern FILE* trace_file;
+extern unsigned long trace_packets;
+void trace_tx(uint8_t byte);
+
+// Tabletop world.
+void world_init(world_t* world, double width, double height, double x, double y, double heading);
+void world_add_block(world_t* world, double x, double y, uint8_t color);
+void world_add_obstacle(world_t* world, double x, double y, double r);
+void world_step(world_t* world, double dt, uint16_t ocr_a, uint16_t ocr_b);
+uint8_t world_ground(const world_t* world);
+uint16_t world_proximity(const world_t* world, int right);
+int world_remaining(const world_t* world);
+
+// Synthetic camera.
+extern unsigned long camera_packets;
+extern unsigned long camera_overflows;
+void camera_init(const camera_config_t* config, unsigned long seed);
+void camera_receive(uint8_t byte);
+void camera_step(const world_t* world);
+int camera_transmit(uint8_t* byte);
+uint32_t camera_baud(void);
+
+// Standard scenarios and runs.
+extern const scenario_t scenarios[];
+extern const int scenario_count;
+int sim_run(const scenario_t* scenario, const sim_options_t* options, sim_result_t* result);
+int sim_run_process(const scenario_t* scenario, const sim_options_t* options, sim_result_t* result);
+
+// Deterministic random numbers.
+uint32_t sim_random(uint32_t* seed);
+
+#endif // _SIM_H_
@@ -0,0 +1,205 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot firmware benchmarks on the host.  Runs each case in bench.c
+    natively against the simulator registers and reports the time and
+    the instructions and cycles per operation from the CPU performance
+    counters.  The counters need perf_event_open, which may be turned
+    off by kernel.perf_event_paranoid or in containers, in which case
+    only the time is reported.
+
+    usage: tbbench [-t seconds] [case prefix...]
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "bench.h"
+
+// Operations between checks of the clock.
+#define TBBENCH_BATCH           1000
+
+typedef struct
+{
+    int fd;                     // Counter or -1 if not available.
+    uint64_t config;            // Hardware event.
+} tbbench_counter_t;
+
+static tbbench_counter_t tbbench_counters[] =
+{
+    { -1, PERF_COUNT_HW_INSTRUCTIONS },
+    { -1, PERF_COUNT_HW_CPU_CYCLES },
+};
+
+#define TBBENCH_INSTRUCTIONS    0
+#define TBBENCH_CYCLES          1
+#define TBBENCH_COUNTERS        (sizeof(tbbench_counters) / sizeof(tbbench_counters[0]))
+
+
+static double tbbench_now(void)
+// Return the monotonic clock in seconds.
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+static void tbbench_counters_open(void)
+// Open the performance counters for this process in user mode.
+{
+    struct perf_event_attr attr;
+    unsigned i;
+
+    for (i = 0; i < TBBENCH_COUNTERS; ++i)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = tbbench_counters[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        tbbench_counters[i].fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+
+static void tbbench_counters_start(void)
+// Reset and start the counters.
+{
+    unsigned i;
+
+    for (i = 0; i < TBBENCH_COUNTERS; ++i)
+    {
+        if (tbbench_counters[i].fd < 0) continue;
+        ioctl(tbbench_counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(tbbench_counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+
+static void tbbench_counters_stop(double* counts, unsigned long ops)
+// Stop the counters and return the counts per operation, or a negative
+// count for a counter which is not available.
+{
+    uint64_t count;
+    unsigned i;
+
+    for (i = 0; i < TBBENCH_COUNTERS; ++i)
+    {
+        counts[i] = -1.0;
+        if (tbbench_counters[i].fd < 0) continue;
+
+        ioctl(tbbench_counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(tbbench_counters[i].fd, &count, sizeof(count)) == sizeof(count)) counts[i] = (double) count / ops;
+    }
+}
+
+
+static void tbbench_print_count(double count)
+// Print a count per operation.
+{
+    if (count < 0) printf(" %10s", "-");
+    else printf(" %10.1f", count);
+}
+
+
+static void tbbench_run(const bench_t* bench, double seconds)
+// Run a case for the given time and print the costs per operation.
+{
+    double counts[TBBENCH_COUNTERS];
+    unsigned long ops = 0;
+    double start, elapsed;
+    int i;
+
+    bench->setup();
+
+    // Warm the caches and branch predictors.
+    for (i = 0; i < TBBENCH_BATCH; ++i) bench->op();
+
+    tbbench_counters_start();
+    start = tbbench_now();
+    do
+    {
+        for (i = 0; i < TBBENCH_BATCH; ++i) bench->op();
+        ops += TBBENCH_BATCH;
+        elapsed = tbbench_now() - start;
+    } while (elapsed < seconds);
+    tbbench_counters_stop(counts, ops);
+
+    printf("%-40s %10.1f", bench->name, elapsed * 1e9 / ops);
+    tbbench_print_count(counts[TBBENCH_INSTRUCTIONS]);
+    tbbench_print_count(counts[TBBENCH_CYCLES]);
+    printf("\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    double seconds = 0.2;
+    int opt;
+    int i, j;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': seconds = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [case...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    bench_init();
+    tbbench_counters_open();
+    if (tbbench_counters[TBBENCH_INSTRUCTIONS].fd < 0)
+        fprintf(stderr, "performance counters not available, timing only\n");
+
+    printf("%-40s %10s %10s %10s\n", "case", "ns/op", "instr/op", "cycles/op");
+
+    for (i = 0; i < bench_count; ++i)
+    {
+        // Run the cases starting with the names given or all of them.
+        for (j = optind; (j < argc) && strncmp(argv[j], benches[i].name, strlen(argv[j])); ++j);
+        if ((optind < argc) && (j == argc)) continue;
+
+        tbbench_run(&benches[i], seconds);
+    }
+
+    return 0;
+}
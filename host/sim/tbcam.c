@@ -0,0 +1,312 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot camera emulator.  Serves the synthetic camera on a pseudo
+    terminal in real time, or runs it against the firmware through the
+    simulated USART, with the stress options set from the command line.
+
+    With no mode the camera is served on a new pty whose name is printed,
+    looking at a still scenario table.  Anything which opens the pty as a
+    serial port, such as an AVR simulator or a test harness, can talk to
+    it with the DT, PG and ET commands.
+
+    -s runs the firmware against the camera for the given time and
+    reports the packets sent and processed and any bytes lost.  -m finds
+    the highest packet rate the firmware sustains: the packets sent are
+    all processed and no byte is lost from the 64 byte receive buffer.
+    -L sets the time the firmware takes for a pass of its main loop as
+    the simulator otherwise makes a pass every 100 us.
+
+    usage: tbcam [-s | -m] [-f fps] [-n boxes] [-j jitter_us] [-u burst]
+                 [-x corrupt_permille] [-g garbage_permille] [-a ack_ms]
+                 [-d drop_percent] [-c boot_ms] [-S scenario] [-t seconds]
+                 [-L loop_us] [-r seed]
+*/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include "sim.h"
+#include "../../clock.h"
+#include "../../usart.h"
+
+// Packets which may still be in flight when a run ends.
+#define TBCAM_IN_FLIGHT         2
+
+static uint64_t tbcam_now_us(void)
+// Return the monotonic clock in microseconds.
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+static int tbcam_pty(const camera_config_t* config, const scenario_t* scenario, unsigned long seed)
+// Serve the camera on a pty until killed.  Returns non-zero on error.
+{
+    uint8_t buffer[256];
+    world_t world;
+    struct termios tio;
+    struct pollfd fds;
+    uint64_t start, last, report;
+    double credit = 0;
+    unsigned long packets = 0;
+    const char* name;
+    int master, slave;
+    ssize_t n, i;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || grantpt(master) || unlockpt(master) || !(name = ptsname(master)))
+    {
+        perror("pty");
+        return 1;
+    }
+
+    // Keep the other end open in raw mode so the pty stays up between
+    // clients and passes every byte through unchanged.
+    slave = open(name, O_RDWR | O_NOCTTY);
+    if ((slave < 0) || tcgetattr(slave, &tio))
+    {
+        perror(name);
+        return 1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    scenario->setup(&world);
+    camera_init(config, seed);
+
+    printf("camera on %s at %lu baud\n", name, (unsigned long) camera_baud());
+    fflush(stdout);
+
+    start = last = report = tbcam_now_us();
+    fds.fd = master;
+    fds.events = POLLIN;
+
+    for (;;)
+    {
+        uint64_t now;
+
+        // Take commands, waking at least each millisecond for the frames.
+        if (poll(&fds, 1, 1) > 0)
+        {
+            n = read(master, buffer, sizeof(buffer));
+            for (i = 0; i < n; ++i) camera_receive(buffer[i]);
+        }
+
+        now = tbcam_now_us();
+        avr_time_us = now - start;
+        camera_step(&world);
+
+        // Send at the line rate.
+        credit += (double) (now - last) * camera_baud() / 10e6;
+        if (credit > sizeof(buffer)) credit = sizeof(buffer);
+        last = now;
+
+        for (n = 0; (credit >= 1.0) && camera_transmit(&buffer[n]); ++n) credit -= 1.0;
+        if ((n > 0) && (write(master, buffer, n) != n))
+        {
+            perror("write");
+            return 1;
+        }
+
+        // Report the packet rate every five seconds.
+        if (now - report >= 5000000)
+        {
+            fprintf(stderr, "%lu packets, %.1f per second, %lu bytes lost\n", camera_packets,
+                    (camera_packets - packets) * 1e6 / (now - report), camera_overflows);
+            packets = camera_packets;
+            report = now;
+        }
+    }
+}
+
+
+static int tbcam_run(const scenario_t* scenario, const sim_options_t* options, sim_result_t* result)
+// Run the firmware against the camera.  Returns 1 if the packet rate was
+// sustained, 0 if not and -1 on error.  A rate faster than the line can
+// carry is not sustained either.
+{
+    if (sim_run_process(scenario, options, result)) return -1;
+
+    return (result->recv_overflows == 0) && (result->camera_overflows == 0) &&
+           (result->processed + TBCAM_IN_FLIGHT >= result->packets);
+}
+
+
+static void tbcam_print_header(void)
+// Print the run table header.
+{
+    printf("%6s %8s %8s %9s %9s %9s %9s %7s\n", "fps", "bytes/s", "sent", "processed", "overflows", "errors", "line", "result");
+}
+
+
+static unsigned tbcam_bytes_per_second(const camera_config_t* config)
+// Return the bytes per second the camera sends with only the extra boxes
+// in view.
+{
+    return config->fps * (3 + 5 * ((config->boxes < 8) ? config->boxes : 8));
+}
+
+
+static void tbcam_print(const sim_options_t* options, const sim_result_t* result, int sustained)
+// Print a run.
+{
+    printf("%6u %8u %8lu %9lu %9u %9u %9lu %7s\n", options->camera.fps, tbcam_bytes_per_second(&options->camera),
+           result->packets, result->processed, result->recv_overflows, result->recv_errors, result->camera_overflows,
+           sustained ? "ok" : "LOST");
+}
+
+
+static int tbcam_benchmark(const scenario_t* scenario, sim_options_t* options)
+// Find the highest packet rate the firmware sustains by raising the rate
+// until packets are lost and then bisecting.  Returns non-zero on error.
+{
+    sim_result_t result;
+    unsigned good = 0;
+    unsigned bad = 0;
+    unsigned fps;
+    int sustained;
+
+    tbcam_print_header();
+
+    // Raise the rate by a quarter each run until packets are lost.
+    for (fps = 10; !bad; fps += (fps + 3) / 4)
+    {
+        options->camera.fps = fps;
+        sustained = tbcam_run(scenario, options, &result);
+        if (sustained < 0) return 1;
+        tbcam_print(options, &result, sustained);
+
+        if (sustained) good = fps;
+        else bad = fps;
+
+        // A frame a step is the most the simulator can send.
+        if (fps >= 1000000 / SIM_STEP_US) break;
+    }
+
+    // Bisect between the last rate sustained and the first which was not.
+    while (bad && (bad - good > 1))
+    {
+        options->camera.fps = fps = (good + bad) / 2;
+        sustained = tbcam_run(scenario, options, &result);
+        if (sustained < 0) return 1;
+        tbcam_print(options, &result, sustained);
+
+        if (sustained) good = fps;
+        else bad = fps;
+    }
+
+    options->camera.fps = good;
+    printf("highest sustained rate %u fps with %u extra boxes, main loop pass %u us, "
+           "%u bytes/s with the line carrying %lu\n", good, options->camera.boxes, options->loop_us,
+           tbcam_bytes_per_second(&options->camera), (unsigned long) camera_baud() / 10);
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    sim_options_t options = SIM_OPTIONS_DEFAULT;
+    const scenario_t* scenario = NULL;
+    const char* name = NULL;
+    sim_result_t result;
+    int mode = 0;
+    int sustained;
+    int opt;
+    int i;
+
+    // Stress runs wander an empty table so they never finish early.
+    options.seconds = 10.0;
+
+    while ((opt = getopt(argc, argv, "smf:n:j:u:x:g:a:d:c:S:t:L:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+            case 'm': mode = opt; break;
+            case 'f': options.camera.fps = (unsigned) atoi(optarg); break;
+            case 'n': options.camera.boxes = (unsigned) atoi(optarg); break;
+            case 'j': options.camera.jitter_us = (unsigned) atoi(optarg); break;
+            case 'u': options.camera.burst = (unsigned) atoi(optarg); break;
+            case 'x': options.camera.corrupt_permille = (unsigned) atoi(optarg); break;
+            case 'g': options.camera.garbage_permille = (unsigned) atoi(optarg); break;
+            case 'a': options.camera.ack_ms = (unsigned) atoi(optarg); break;
+            case 'd': options.camera.drop_percent = (unsigned) atoi(optarg); break;
+            case 'c': options.camera.boot_ms = (unsigned) atoi(optarg); break;
+            case 'S': name = optarg; break;
+            case 't': options.seconds = atof(optarg); break;
+            case 'L': options.loop_us = (unsigned) atoi(optarg); break;
+            case 'r': options.seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-s | -m] [-f fps] [-n boxes] [-j jitter_us] [-u burst]\n"
+                                "       [-x corrupt_permille] [-g garbage_permille] [-a ack_ms] [-d drop_percent]\n"
+                                "       [-c boot_ms] [-S scenario] [-t seconds] [-L loop_us] [-r seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (!options.camera.fps) options.camera.fps = 30;
+    if (options.loop_us < SIM_STEP_US) options.loop_us = SIM_STEP_US;
+
+    // The pty camera looks at a block by default, the firmware runs on an
+    // empty table.
+    if (!name) name = mode ? "edge" : "single";
+    for (i = 0; i < scenario_count; ++i)
+    {
+        if (!strcmp(name, scenarios[i].name)) scenario = &scenarios[i];
+    }
+    if (!scenario)
+    {
+        fprintf(stderr, "unknown scenario %s\n", name);
+        return 2;
+    }
+
+    if (mode == 'm') return tbcam_benchmark(scenario, &options);
+
+    if (mode == 's')
+    {
+        sustained = tbcam_run(scenario, &options, &result);
+        if (sustained < 0) return 1;
+        tbcam_print_header();
+        tbcam_print(&options, &result, sustained);
+        return sustained ? 0 : 1;
+    }
+
+    return tbcam_pty(&options.camera, scenario, options.seed);
+}
@@ -0,0 +1,292 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot replay.  Feeds captured inputs into the firmware as fast as
+    the host allows and compares the output trace with the golden file
+    next to each capture, the capture name with its extension replaced by
+    .golden.  Each capture replays in its own process so the firmware
+    starts from reset, and a replay is deterministic so any difference
+    is a change in behavior.
+
+    Captures and golden files come from tbsim -w and -g, and -u rewrites
+    the golden files from the replays once a change in behavior is
+    intended.  -o writes the trace of a single capture to a file.  -e
+    skips the main loop passes in which the firmware would be idle, which
+    must not change any trace.
+
+    usage: tbreplay [-u] [-e] [-o trace] capture...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+typedef struct
+{
+    char* data;
+    size_t length;
+} replay_buffer_t;
+
+static int replay_event_step;
+
+static int replay_run(const char* path, int fd)
+// Replay a capture from power on writing the trace to the file
+// descriptor.  Returns 0 on success.
+{
+    capture_t capture;
+    capture_record_t next;
+
+    if (capture_open(&capture, path))
+    {
+        fprintf(stderr, "%s: not a capture\n", path);
+        return -1;
+    }
+    if (capture_read(&capture, &next) != 1) next.type = CAPTURE_END, next.time_us = 0;
+
+    trace_file = fdopen(fd, "w");
+    if (!trace_file) return -1;
+
+    // Power on and run until the inputs end.
+    avr_init();
+    tablebot_init();
+    while (avr_replay_step(&capture, &next)) avr_loop(replay_event_step);
+
+    capture_close(&capture, 0);
+    return fclose(trace_file) ? -1 : 0;
+}
+
+
+static int replay_process(const char* path, replay_buffer_t* trace)
+// Replay a capture in a child process and collect its trace.  Returns 0
+// on success.
+{
+    int fds[2];
+    pid_t pid;
+    ssize_t n;
+    size_t size = 0;
+    int status;
+
+    trace->data = NULL;
+    trace->length = 0;
+
+    if (pipe(fds)) return -1;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) return -1;
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        _exit(replay_run(path, fds[1]) ? 1 : 0);
+    }
+
+    close(fds[1]);
+    for (;;)
+    {
+        if (trace->length == size)
+        {
+            size = size ? size * 2 : 65536;
+            trace->data = realloc(trace->data, size);
+            if (!trace->data) break;
+        }
+        n = read(fds[0], trace->data + trace->length, size - trace->length);
+        if (n <= 0) break;
+        trace->length += n;
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return (trace->data && WIFEXITED(status) && !WEXITSTATUS(status)) ? 0 : -1;
+}
+
+
+static int replay_load(const char* path, replay_buffer_t* buffer)
+// Read a whole file.  Returns 0 on success.
+{
+    FILE* file = fopen(path, "rb");
+    long length;
+
+    buffer->data = NULL;
+    buffer->length = 0;
+
+    if (!file) return -1;
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer->data = malloc(length + 1);
+    if (buffer->data) buffer->length = fread(buffer->data, 1, length, file);
+    fclose(file);
+
+    return (buffer->data && (buffer->length == (size_t) length)) ? 0 : -1;
+}
+
+
+static int replay_save(const char* path, const replay_buffer_t* buffer)
+// Write a whole file.  Returns 0 on success.
+{
+    FILE* file = fopen(path, "wb");
+    int error = 0;
+
+    if (!file) return -1;
+
+    if (fwrite(buffer->data, 1, buffer->length, file) != buffer->length) error = -1;
+    if (fclose(file)) error = -1;
+
+    return error;
+}
+
+
+static void replay_difference(const replay_buffer_t* golden, const replay_buffer_t* trace)
+// Print the first line where the trace differs from the golden file.
+{
+    size_t i = 0;
+    size_t start = 0;
+    int line = 1;
+    const char* end;
+
+    while ((i < golden->length) && (i < trace->length) && (golden->data[i] == trace->data[i]))
+    {
+        if (golden->data[i++] == '\n')
+        {
+            start = i;
+            ++line;
+        }
+    }
+
+    printf("    line %d\n", line);
+
+    end = (start < golden->length) ? memchr(golden->data + start, '\n', golden->length - start) : NULL;
+    printf("    golden: %.*s\n", (int) ((end ? end : golden->data + golden->length) - (golden->data + start)),
+           golden->data + start);
+    end = (start < trace->length) ? memchr(trace->data + start, '\n', trace->length - start) : NULL;
+    printf("    replay: %.*s\n", (int) ((end ? end : trace->data + trace->length) - (trace->data + start)),
+           trace->data + start);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* output = NULL;
+    int update = 0;
+    int passed = 0;
+    int failed = 0;
+    int opt;
+    int i;
+    struct timeval start, end;
+
+    while ((opt = getopt(argc, argv, "ueo:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'u': update = 1; break;
+            case 'e': replay_event_step = 1; break;
+            case 'o': output = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-u] [-e] [-o trace] capture...\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((optind >= argc) || (output && (optind + 1 != argc)))
+    {
+        fprintf(stderr, "usage: %s [-u] [-e] [-o trace] capture...\n", argv[0]);
+        return 2;
+    }
+
+    gettimeofday(&start, NULL);
+
+    for (i = optind; i < argc; ++i)
+    {
+        const char* path = argv[i];
+        const char* dot = strrchr(path, '.');
+        const char* slash = strrchr(path, '/');
+        replay_buffer_t trace;
+        replay_buffer_t golden;
+        char* golden_path;
+        size_t stem;
+
+        // The golden file replaces the capture extension.
+        stem = (dot && (!slash || (dot > slash))) ? (size_t) (dot - path) : strlen(path);
+        golden_path = malloc(stem + sizeof(".golden"));
+        if (!golden_path) return 1;
+        memcpy(golden_path, path, stem);
+        strcpy(golden_path + stem, ".golden");
+
+        if (replay_process(path, &trace))
+        {
+            printf("%-40s error\n", path);
+            ++failed;
+        }
+        else if (output)
+        {
+            if (replay_save(output, &trace)) perror(output), ++failed;
+            else ++passed;
+        }
+        else if (update)
+        {
+            if (replay_save(golden_path, &trace)) perror(golden_path), ++failed;
+            else printf("%-40s updated\n", path), ++passed;
+        }
+        else if (replay_load(golden_path, &golden))
+        {
+            printf("%-40s no golden file %s\n", path, golden_path);
+            ++failed;
+        }
+        else
+        {
+            if ((golden.length == trace.length) && !memcmp(golden.data, trace.data, trace.length))
+            {
+                printf("%-40s pass\n", path);
+                ++passed;
+            }
+            else
+            {
+                printf("%-40s FAIL\n", path);
+                replay_difference(&golden, &trace);
+                ++failed;
+            }
+            free(golden.data);
+        }
+
+        free(trace.data);
+        free(golden_path);
+    }
+
+    gettimeofday(&end, NULL);
+    fflush(stdout);
+    fprintf(stderr, "%d passed, %d failed, %.2f s of host time\n", passed, failed,
+            (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot simulator.  Runs the firmware main loop unmodified against
+    simulated peripherals, a tabletop world and a synthetic camera in
+    virtual time, and scores standard scenarios.  Each scenario runs in
+    its own process so it starts from a freshly reset firmware.
+
+    With -w the inputs of the scenario are captured for tbreplay and with
+    -g its outputs are traced to make the golden file for the capture.
+    -e skips the main loop passes in which the firmware would be idle,
+    which gives the same results in less host time.
+
+    usage: tbsim [-s scenario] [-t seconds] [-r seed] [-c boot_ms]
+                 [-d drop_percent] [-w capture] [-g trace] [-e] [-v] [-l]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "sim.h"
+
+static void sim_print(const char* name, const sim_result_t* result)
+// Print the scenario metrics.
+{
+    const world_t* world = &result->world;
+    char clear[16];
+
+    if (world->clear_time >= 0) snprintf(clear, sizeof(clear), "%.2f", world->clear_time);
+    else snprintf(clear, sizeof(clear), "-");
+
+    printf("%-10s %8s %5d/%-3d %5d %8d %10.2f %8lu %5lu\n",
+           name, clear, world->cleared, result->blocks, world->falls, world->markers_lost,
+           world->distance, result->packets, result->wdt_expired);
+}
+
+
+int main(int argc, char* argv[])
+{
+    sim_options_t options = SIM_OPTIONS_DEFAULT;
+    const char* name = NULL;
+    sim_result_t result;
+    int i;
+    int opt;
+    int failed = 0;
+    int ran = 0;
+    unsigned long passes = 0;
+    unsigned long skipped = 0;
+    struct timeval start, end;
+
+    while ((opt = getopt(argc, argv, "s:t:r:c:d:w:g:evl")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': name = optarg; break;
+            case 't': options.seconds = atof(optarg); break;
+            case 'r': options.seed = strtoul(optarg, NULL, 0); break;
+            case 'c': options.camera.boot_ms = (unsigned) atoi(optarg); break;
+            case 'd': options.camera.drop_percent = (unsigned) atoi(optarg); break;
+            case 'w': options.capture_path = optarg; break;
+            case 'g': options.trace_path = optarg; break;
+            case 'e': options.event_step = 1; break;
+            case 'v': options.verbose = 1; break;
+            case 'l':
+                for (i = 0; i < scenario_count; ++i) printf("%-10s %s\n", scenarios[i].name, scenarios[i].description);
+                return 0;
+            default:
+                fprintf(stderr, "usage: %s [-s scenario] [-t seconds] [-r seed] [-c boot_ms] [-d drop_percent]\n"
+                                "       [-w capture] [-g trace] [-e] [-v] [-l]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((options.capture_path || options.trace_path) && !name)
+    {
+        fprintf(stderr, "capturing or tracing needs a scenario\n");
+        return 2;
+    }
+
+    gettimeofday(&start, NULL);
+    printf("%-10s %8s %9s %5s %8s %10s %8s %5s\n",
+           "scenario", "clear_s", "cleared", "falls", "markers", "distance_m", "packets", "wdt");
+
+    for (i = 0; i < scenario_count; ++i)
+    {
+        if (name && strcmp(name, scenarios[i].name)) continue;
+
+        ++ran;
+        fflush(stdout);
+        if (sim_run_process(&scenarios[i], &options, &result))
+        {
+            printf("%-10s failed\n", scenarios[i].name);
+            ++failed;
+            continue;
+        }
+        sim_print(scenarios[i].name, &result);
+        passes += result.passes;
+        skipped += result.skipped;
+    }
+
+    if (!ran)
+    {
+        fprintf(stderr, "unknown scenario %s\n", name);
+        return 2;
+    }
+
+    gettimeofday(&end, NULL);
+    fflush(stdout);
+    fprintf(stderr, "%.2f s of host time", (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+    if (options.event_step && (passes + skipped))
+    {
+        fprintf(stderr, ", %.1f%% of main loop passes skipped", 100.0 * skipped / (passes + skipped));
+    }
+    fprintf(stderr, "\n");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,409 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    TableBot behavior tuner.  Runs many simulated episodes of the
+    firmware for each combination of tunable values and ranks the
+    combinations by failure rate and time to clear the table.
+
+    The firmware keeps its state in globals, so episodes run in separate
+    processes rather than threads.  A pool of worker processes takes
+    episodes from a shared counter until none are left, so a slow
+    episode never holds up the others, and each worker runs an episode
+    in a freshly forked child so the firmware starts from reset.
+
+    Values are swept over a grid of every combination, or with -n over
+    that many combinations drawn at random.  Every combination runs the
+    same episodes with the same seeds.  The firmware defaults are always
+    included as the first combination.
+
+    usage: tbtune [-p name=lo:hi[:step] | -p name=a,b,...]... [-n configs]
+                  [-e episodes] [-s scenario] [-t seconds] [-j workers]
+                  [-r seed] [-c boot_ms] [-d drop_percent] [-k top]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+// Limits on the values swept for each tunable and the combinations run.
+#define TUNE_VALUES_MAX         1024
+#define TUNE_CONFIGS_MAX        100000
+
+typedef struct
+{
+    int count;                              // Values to sweep, none if zero.
+    int16_t values[TUNE_VALUES_MAX];
+} tune_sweep_t;
+
+typedef struct
+{
+    int16_t value[TUNE_COUNT];
+    uint8_t set[TUNE_COUNT];
+} tune_config_t;
+
+typedef struct
+{
+    float clear_time;                       // Seconds to clear, or -1.
+    uint8_t done;
+    uint8_t failed;                         // Did not clear, fell, lost a marker or reset.
+} tune_episode_t;
+
+typedef struct
+{
+    int config;
+    int episodes;
+    int failures;
+    double seconds;                         // Total time to clear, counting failures
+                                            // at the time limit.
+} tune_score_t;
+
+typedef struct
+{
+    unsigned long next;                     // Next episode to take.
+    tune_episode_t episodes[];
+} tune_shared_t;
+
+static tune_sweep_t tune_sweeps[TUNE_COUNT];
+
+static int tune_parse(const char* arg)
+// Parse a name=lo:hi[:step] or name=a,b,... sweep.  Returns 0 on success.
+{
+    tune_sweep_t* sweep;
+    const char* equals = strchr(arg, '=');
+    long lo, hi, step = 1;
+    char* end;
+    int i;
+
+    if (!equals) return -1;
+
+    for (i = 0; i < TUNE_COUNT; ++i)
+    {
+        if ((strlen(tune_names[i]) == (size_t) (equals - arg)) && !strncmp(arg, tune_names[i], equals - arg)) break;
+    }
+    if (i == TUNE_COUNT) return -1;
+
+    sweep = &tune_sweeps[i];
+    sweep->count = 0;
+
+    if (strchr(equals, ':'))
+    {
+        lo = strtol(equals + 1, &end, 0);
+        if (*end != ':') return -1;
+        hi = strtol(end + 1, &end, 0);
+        if (*end == ':') step = strtol(end + 1, &end, 0);
+        if (*end || (step <= 0) || (hi < lo)) return -1;
+
+        for (; (lo <= hi) && (sweep->count < TUNE_VALUES_MAX); lo += step) sweep->values[sweep->count++] = (int16_t) lo;
+    }
+    else
+    {
+        end = (char*) equals;
+        do
+        {
+            if (sweep->count >= TUNE_VALUES_MAX) return -1;
+            sweep->values[sweep->count++] = (int16_t) strtol(end + 1, &end, 0);
+        }
+        while (*end == ',');
+        if (*end) return -1;
+    }
+
+    return 0;
+}
+
+
+static int tune_configs(tune_config_t* configs, int random_count, uint32_t seed)
+// Fill in the combinations to run after the defaults.  Returns the count.
+{
+    int count = 1;
+    int i, n;
+
+    memset(configs, 0, sizeof(*configs));
+
+    if (random_count)
+    {
+        // Draw each combination at random.
+        for (n = 0; (n < random_count) && (count < TUNE_CONFIGS_MAX); ++n, ++count)
+        {
+            memset(&configs[count], 0, sizeof(configs[count]));
+            for (i = 0; i < TUNE_COUNT; ++i)
+            {
+                if (!tune_sweeps[i].count) continue;
+                configs[count].value[i] = tune_sweeps[i].values[sim_random(&seed) % tune_sweeps[i].count];
+                configs[count].set[i] = 1;
+            }
+        }
+        return count;
+    }
+
+    // Step through every combination like an odometer.
+    {
+        int index[TUNE_COUNT] = { 0 };
+
+        for (;;)
+        {
+            if (count >= TUNE_CONFIGS_MAX) return count;
+
+            memset(&configs[count], 0, sizeof(configs[count]));
+            for (i = 0; i < TUNE_COUNT; ++i)
+            {
+                if (!tune_sweeps[i].count) continue;
+                configs[count].value[i] = tune_sweeps[i].values[index[i]];
+                configs[count].set[i] = 1;
+            }
+            ++count;
+
+            for (i = 0; i < TUNE_COUNT; ++i)
+            {
+                if (!tune_sweeps[i].count) continue;
+                if (++index[i] < tune_sweeps[i].count) break;
+                index[i] = 0;
+            }
+            if (i == TUNE_COUNT) return count;
+        }
+    }
+}
+
+
+static void tune_worker(tune_shared_t* shared, unsigned long total, const tune_config_t* configs,
+                        const scenario_t** selected, int scenarios_selected, int episodes,
+                        const sim_options_t* base)
+// Run episodes until there are none left.
+{
+    sim_options_t options = *base;
+    sim_result_t result;
+    unsigned long job;
+    const tune_config_t* config;
+    const scenario_t* scenario;
+    int episode;
+
+    while ((job = __atomic_fetch_add(&shared->next, 1, __ATOMIC_RELAXED)) < total)
+    {
+        // Jobs run every episode of a combination before the next.
+        config = &configs[job / (scenarios_selected * episodes)];
+        scenario = selected[(job / episodes) % scenarios_selected];
+        episode = job % episodes;
+
+        memcpy(options.tune_value, config->value, sizeof(options.tune_value));
+        memcpy(options.tune_set, config->set, sizeof(options.tune_set));
+        options.seed = base->seed + episode + 1;
+
+        if (sim_run_process(scenario, &options, &result))
+        {
+            shared->episodes[job].clear_time = -1;
+            shared->episodes[job].failed = 1;
+        }
+        else
+        {
+            const world_t* world = &result.world;
+
+            shared->episodes[job].clear_time = (float) world->clear_time;
+            shared->episodes[job].failed = (result.blocks && (world->clear_time < 0)) ||
+                                           world->falls || world->markers_lost || result.wdt_expired;
+        }
+        shared->episodes[job].done = 1;
+    }
+}
+
+
+static int tune_compare(const void* a, const void* b)
+// Order scores by failure rate and then by mean time to clear.
+{
+    const tune_score_t* sa = a;
+    const tune_score_t* sb = b;
+
+    if (sa->failures != sb->failures) return sa->failures - sb->failures;
+    if (sa->seconds < sb->seconds) return -1;
+    if (sa->seconds > sb->seconds) return 1;
+    return sa->config - sb->config;
+}
+
+
+int main(int argc, char* argv[])
+{
+    sim_options_t options = SIM_OPTIONS_DEFAULT;
+    const scenario_t* selected[16];
+    int selected_blocks[16];
+    int scenarios_selected = 0;
+    world_t world;
+    const char* name = NULL;
+    tune_config_t* configs;
+    tune_score_t* scores;
+    tune_shared_t* shared;
+    unsigned long total, job;
+    int config_count;
+    int random_count = 0;
+    int episodes = 4;
+    int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int top = 20;
+    int timed;
+    int i, opt;
+    struct timeval start, end;
+    double wall;
+
+    while ((opt = getopt(argc, argv, "p:n:e:s:t:j:r:c:d:k:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                if (tune_parse(optarg))
+                {
+                    fprintf(stderr, "bad sweep %s, tunables are:", optarg);
+                    for (i = 0; i < TUNE_COUNT; ++i) fprintf(stderr, " %s", tune_names[i]);
+                    fprintf(stderr, "\n");
+                    return 2;
+                }
+                break;
+            case 'n': random_count = atoi(optarg); break;
+            case 'e': episodes = atoi(optarg); break;
+            case 's': name = optarg; break;
+            case 't': options.seconds = atof(optarg); break;
+            case 'j': workers = atoi(optarg); break;
+            case 'r': options.seed = strtoul(optarg, NULL, 0); break;
+            case 'c': options.camera.boot_ms = (unsigned) atoi(optarg); break;
+            case 'd': options.camera.drop_percent = (unsigned) atoi(optarg); break;
+            case 'k': top = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-p name=lo:hi[:step] | -p name=a,b,...]... [-n configs] [-e episodes]\n"
+                                "       [-s scenario] [-t seconds] [-j workers] [-r seed] [-c boot_ms] [-d drop_percent] [-k top]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (episodes < 1) episodes = 1;
+    if (workers < 1) workers = 1;
+
+    // Select the scenarios.
+    for (i = 0; (i < scenario_count) && (scenarios_selected < (int) (sizeof(selected) / sizeof(selected[0]))); ++i)
+    {
+        if (name && strcmp(name, scenarios[i].name)) continue;
+
+        // Note which scenarios have blocks to clear.
+        scenarios[i].setup(&world);
+        selected_blocks[scenarios_selected] = world_remaining(&world);
+        selected[scenarios_selected++] = &scenarios[i];
+    }
+    if (!scenarios_selected)
+    {
+        fprintf(stderr, "unknown scenario %s\n", name);
+        return 2;
+    }
+
+    // Build the combinations.
+    configs = malloc(TUNE_CONFIGS_MAX * sizeof(*configs));
+    if (!configs) return 1;
+    config_count = tune_configs(configs, random_count, (uint32_t) options.seed | 1);
+    total = (unsigned long) config_count * scenarios_selected * episodes;
+
+    // The episode results are shared with the workers.
+    shared = mmap(NULL, sizeof(*shared) + total * sizeof(shared->episodes[0]),
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    fprintf(stderr, "%d combinations, %lu episodes, %d workers\n", config_count, total, workers);
+    fflush(stdout);
+    gettimeofday(&start, NULL);
+
+    // Start the workers and wait for them to finish.
+    for (i = 0; i < workers; ++i)
+    {
+        pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            tune_worker(shared, total, configs, selected, scenarios_selected, episodes, &options);
+            _exit(0);
+        }
+        if (pid < 0)
+        {
+            perror("fork");
+            break;
+        }
+    }
+    while (wait(NULL) > 0);
+
+    gettimeofday(&end, NULL);
+    wall = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+
+    // Score each combination.
+    scores = calloc(config_count, sizeof(*scores));
+    if (!scores) return 1;
+    for (i = 0; i < config_count; ++i) scores[i].config = i;
+
+    // Only scenarios with blocks to clear count toward the time.
+    timed = 0;
+    for (i = 0; i < scenarios_selected; ++i) if (selected_blocks[i]) timed += episodes;
+
+    for (job = 0; job < total; ++job)
+    {
+        tune_score_t* score = &scores[job / (scenarios_selected * episodes)];
+        const tune_episode_t* episode = &shared->episodes[job];
+
+        ++score->episodes;
+        if (!episode->done || episode->failed) ++score->failures;
+        if (selected_blocks[(job / episodes) % scenarios_selected])
+        {
+            score->seconds += (episode->done && (episode->clear_time >= 0)) ? episode->clear_time : options.seconds;
+        }
+    }
+
+    qsort(scores, config_count, sizeof(*scores), tune_compare);
+
+    // Print the ranked table.
+    printf("%4s %6s %8s", "rank", "fail%", "clear_s");
+    for (i = 0; i < TUNE_COUNT; ++i) printf(" %13s", tune_names[i]);
+    printf("\n");
+
+    for (i = 0; (i < config_count) && (i < top); ++i)
+    {
+        const tune_score_t* score = &scores[i];
+        const tune_config_t* config = &configs[score->config];
+        int t;
+
+        printf("%4d %6.1f %8.2f", i + 1, 100.0 * score->failures / score->episodes,
+               timed ? score->seconds / timed : 0.0);
+        for (t = 0; t < TUNE_COUNT; ++t)
+        {
+            if (config->set[t]) printf(" %13d", config->value[t]);
+            else printf(" %13s", "-");
+        }
+        printf("%s\n", score->config ? "" : "  (defaults)");
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "%.2f s of host time, %.1f episodes per second\n", wall, total / wall);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Output traces.  While a trace is open every event the firmware
+    records and every byte it transmits to the camera is written as a
+    line of text with its virtual time.  Two runs behave the same if and
+    only if their traces match, so a trace makes a golden file for
+    replayed captures.
+
+    The firmware's recorder_event() calls are routed here by linking with
+    --wrap=recorder_event.
+*/
+
+#include <stdio.h>
+#include "sim.h"
+#include "../../recorder.h"
+
+FILE* trace_file;
+unsigned long trace_packets;
+
+// Event names by recorder event type.
+static const char* const trace_names[] =
+{
+    [RECORDER_TIME]         = "time",
+    [RECORDER_RESET]        = "reset",
+    [RECORDER_TABLEBOT]     = "tablebot",
+    [RECORDER_CAMERA]       = "camera",
+    [RECORDER_SENSORS]      = "sensors",
+    [RECORDER_REFLEX]       = "reflex",
+    [RECORDER_PACKET]       = "packet",
+    [RECORDER_TIMEOUT]      = "timeout",
+    [RECORDER_PWM_A]        = "pwm_a",
+    [RECORDER_PWM_B]        = "pwm_b",
+    [RECORDER_RESYNC]       = "resync",
+    [RECORDER_RECOVER]      = "recover",
+    [RECORDER_FIRST_BLOB]   = "first_blob",
+    [RECORDER_BAUD]         = "baud",
+};
+
+void __real_recorder_event(uint8_t type, uint8_t a, uint8_t b);
+
+void __wrap_recorder_event(uint8_t type, uint8_t a, uint8_t b)
+// Trace a firmware event and record it as usual.
+{
+    // Count the camera packets processed.
+    if (type == RECORDER_PACKET) ++trace_packets;
+
+    if (trace_file && (type != RECORDER_TIME))
+    {
+        if ((type < sizeof(trace_names) / sizeof(trace_names[0])) && trace_names[type])
+        {
+            fprintf(trace_file, "%9.4f %s %u %u\n", avr_time_us / 1e6, trace_names[type], a, b);
+        }
+        else
+        {
+            fprintf(trace_file, "%9.4f event%u %u %u\n", avr_time_us / 1e6, type, a, b);
+        }
+    }
+
+    __real_recorder_event(type, a, b);
+}
+
+
+void trace_tx(uint8_t byte)
+// Trace a byte transmitted to the camera.
+{
+    if (trace_file) fprintf(trace_file, "%9.4f tx %02x\n", avr_time_us / 1e6, byte);
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Behavior tunables for the simulator.  This is forced into the
+    firmware main.c build so each TABLEBOT_TUNABLE() reads a value set
+    by the simulator, falling back to the firmware default when unset.
+*/
+
+#ifndef _TUNE_H_
+#define _TUNE_H_ 1
+
+#include <stdint.h>
+
+// Tunable indexes.  The names match the first TABLEBOT_TUNABLE() argument.
+#define TUNE_CRUISE_PWM         0
+#define TUNE_ROTATE_TIME        1
+#define TUNE_TURNAWAY_TIME      2
+#define TUNE_SEARCH_TIME        3
+#define TUNE_SEARCH_STEP        4
+#define TUNE_DEADBAND           5
+
+#define TUNE_COUNT              6
+
+// Values in effect and which of them are set.
+extern int16_t tune_value[TUNE_COUNT];
+extern uint8_t tune_set[TUNE_COUNT];
+
+// Tunable names indexed as above.
+extern const char* const tune_names[TUNE_COUNT];
+
+#define TABLEBOT_TUNABLE(name, value)   (tune_set[TUNE_ ## name] ? tune_value[TUNE_ ## name] : (value))
+
+#endif // _TUNE_H_
@@ -0,0 +1,291 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Tabletop world.  A differential drive robot on a rectangular table
+    with pushable blocks and fixed obstacles.  Motor A drives the right
+    wheel and motor B the left, each at a speed proportional to its PWM
+    with a first order lag.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <avr/io.h>
+#include "sim.h"
+#include "../../motors.h"
+#include "../../sensors.h"
+
+// Robot geometry in meters.
+#define ROBOT_RADIUS            0.07
+#define ROBOT_WHEEL_BASE        0.10
+
+// Wheel speed at full PWM in meters per second and motor time constant.
+#define ROBOT_MAX_SPEED         0.25
+#define ROBOT_MOTOR_TAU         0.05
+
+// Block size in meters.
+#define BLOCK_RADIUS            0.025
+
+// Ground sensor positions relative to the robot center, forward and left.
+static const double world_ground_sensor[SENSOR_COUNT][2] =
+{
+    [SENSOR_LEFT_FRONT]         = {  0.00,  0.00 },
+    [SENSOR_RIGHT_FRONT]        = {  0.00,  0.00 },
+    [SENSOR_GROUND_FRONT]       = {  0.08,  0.00 },
+    [SENSOR_GROUND_LEFT_FRONT]  = {  0.06,  0.05 },
+    [SENSOR_GROUND_RIGHT_FRONT] = {  0.06, -0.05 },
+    [SENSOR_GROUND_LEFT_REAR]   = { -0.06,  0.05 },
+    [SENSOR_GROUND_RIGHT_REAR]  = { -0.06, -0.05 },
+};
+
+// Proximity sensor range and angle off the heading.
+#define PROXIMITY_RANGE         0.5
+#define PROXIMITY_ANGLE         0.35
+#define PROXIMITY_CONE          0.35
+
+static int world_on_table(const world_t* world, double x, double y)
+// Return true if the point is over the table.
+{
+    return (x >= 0) && (y >= 0) && (x <= world->width) && (y <= world->height);
+}
+
+
+void world_init(world_t* world, double width, double height, double x, double y, double heading)
+// Set up an empty table with the robot at rest.
+{
+    memset(world, 0, sizeof(*world));
+    world->width = width;
+    world->height = height;
+    world->x = world->start_x = x;
+    world->y = world->start_y = y;
+    world->heading = world->start_heading = heading;
+    world->clear_time = -1;
+}
+
+
+void world_add_block(world_t* world, double x, double y, uint8_t color)
+// Place a block on the table.
+{
+    world_block_t* block;
+
+    if (world->block_count >= WORLD_BLOCKS) return;
+
+    block = &world->blocks[world->block_count++];
+    block->x = x;
+    block->y = y;
+    block->r = BLOCK_RADIUS;
+    block->color = color;
+    block->on_table = 1;
+}
+
+
+void world_add_obstacle(world_t* world, double x, double y, double r)
+// Place a fixed obstacle on the table.
+{
+    world_obstacle_t* obstacle;
+
+    if (world->obstacle_count >= WORLD_OBSTACLES) return;
+
+    obstacle = &world->obstacles[world->obstacle_count++];
+    obstacle->x = x;
+    obstacle->y = y;
+    obstacle->r = r;
+}
+
+
+int world_remaining(const world_t* world)
+// Return the number of red blocks still on the table.
+{
+    int i;
+    int remaining = 0;
+
+    for (i = 0; i < world->block_count; ++i)
+    {
+        if (world->blocks[i].on_table && (world->blocks[i].color == WORLD_RED)) ++remaining;
+    }
+
+    return remaining;
+}
+
+
+static double world_wheel(uint16_t ocr)
+// Return the wheel speed commanded by the PWM register.
+{
+    double speed = ((double) ocr - MOTORS_IDLE_PWM) / MOTORS_MAX_PWM;
+
+    if (speed > 1.0) speed = 1.0;
+    if (speed < -1.0) speed = -1.0;
+
+    return speed * ROBOT_MAX_SPEED;
+}
+
+
+static void world_separate(double* x, double* y, double ox, double oy, double distance)
+// Move the point away from the other point until they are the distance
+// apart.
+{
+    double dx = *x - ox;
+    double dy = *y - oy;
+    double d = sqrt(dx * dx + dy * dy);
+
+    if (d >= distance) return;
+    if (d < 1e-9) { dx = 1; dy = 0; d = 1; }
+
+    *x = ox + dx * distance / d;
+    *y = oy + dy * distance / d;
+}
+
+
+void world_step(world_t* world, double dt, uint16_t ocr_a, uint16_t ocr_b)
+// Advance the world by the time step.
+{
+    double now = avr_time_us / 1e6;
+    double speed;
+    double x0 = world->x;
+    double y0 = world->y;
+    int i, j;
+
+    // The wheels approach the commanded speeds.
+    world->right += (world_wheel(ocr_a) - world->right) * dt / ROBOT_MOTOR_TAU;
+    world->left += (world_wheel(ocr_b) - world->left) * dt / ROBOT_MOTOR_TAU;
+
+    // Drive.
+    speed = (world->left + world->right) / 2;
+    world->heading += (world->right - world->left) / ROBOT_WHEEL_BASE * dt;
+    world->x += speed * cos(world->heading) * dt;
+    world->y += speed * sin(world->heading) * dt;
+
+    // Obstacles stop the robot.
+    for (i = 0; i < world->obstacle_count; ++i)
+    {
+        world_obstacle_t* obstacle = &world->obstacles[i];
+        world_separate(&world->x, &world->y, obstacle->x, obstacle->y, obstacle->r + ROBOT_RADIUS);
+    }
+
+    world->distance += hypot(world->x - x0, world->y - y0);
+
+    // The robot pushes the blocks and the blocks push each other.
+    for (i = 0; i < world->block_count; ++i)
+    {
+        world_block_t* block = &world->blocks[i];
+
+        if (!block->on_table) continue;
+
+        world_separate(&block->x, &block->y, world->x, world->y, ROBOT_RADIUS + block->r);
+
+        for (j = 0; j < world->obstacle_count; ++j)
+        {
+            world_obstacle_t* obstacle = &world->obstacles[j];
+            world_separate(&block->x, &block->y, obstacle->x, obstacle->y, obstacle->r + block->r);
+        }
+
+        for (j = 0; j < world->block_count; ++j)
+        {
+            world_block_t* other = &world->blocks[j];
+            if ((j == i) || !other->on_table) continue;
+            world_separate(&other->x, &other->y, block->x, block->y, block->r + other->r);
+        }
+    }
+
+    // Blocks fall once their center is off the table.
+    for (i = 0; i < world->block_count; ++i)
+    {
+        world_block_t* block = &world->blocks[i];
+
+        if (!block->on_table || world_on_table(world, block->x, block->y)) continue;
+
+        block->on_table = 0;
+        if (block->color == WORLD_RED)
+        {
+            ++world->cleared;
+            if (!world_remaining(world)) world->clear_time = now;
+        }
+        else
+        {
+            ++world->markers_lost;
+        }
+    }
+
+    // The robot falls once its center is off the table.  Put it back at
+    // the start to carry on.
+    if (!world_on_table(world, world->x, world->y))
+    {
+        ++world->falls;
+        world->x = world->start_x;
+        world->y = world->start_y;
+        world->heading = world->start_heading;
+        world->left = world->right = 0;
+    }
+}
+
+
+uint8_t world_ground(const world_t* world)
+// Return the mask of ground sensors which are over the edge.
+{
+    double c = cos(world->heading);
+    double s = sin(world->heading);
+    uint8_t detected = 0;
+    int i;
+
+    for (i = SENSOR_GROUND_FRONT; i < SENSOR_COUNT; ++i)
+    {
+        double fx = world_ground_sensor[i][0];
+        double fy = world_ground_sensor[i][1];
+
+        if (!world_on_table(world, world->x + fx * c - fy * s, world->y + fx * s + fy * c)) detected |= (1<<i);
+    }
+
+    return detected;
+}
+
+
+uint16_t world_proximity(const world_t* world, int right)
+// Return the proximity sensor reading for the nearest obstacle in the
+// sensor cone.  The reading rises as the obstacle gets closer.
+{
+    double direction = world->heading + (right ? -PROXIMITY_ANGLE : PROXIMITY_ANGLE);
+    double nearest = PROXIMITY_RANGE;
+    double reading;
+    int i;
+
+    for (i = 0; i < world->obstacle_count; ++i)
+    {
+        const world_obstacle_t* obstacle = &world->obstacles[i];
+        double dx = obstacle->x - world->x;
+        double dy = obstacle->y - world->y;
+        double d = hypot(dx, dy) - obstacle->r - ROBOT_RADIUS;
+        double angle = remainder(atan2(dy, dx) - direction, 2 * M_PI);
+
+        if ((fabs(angle) <= PROXIMITY_CONE) && (d < nearest)) nearest = d;
+    }
+
+    if (nearest >= PROXIMITY_RANGE) return 0;
+
+    // About 600 at 10 cm and 200 at 30 cm.
+    reading = 61.4 / ((nearest > 0.06) ? nearest : 0.06);
+
+    return (reading > 1023) ? 1023 : (uint16_t) reading;
+}
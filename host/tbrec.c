@@ -0,0 +1,149 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Flight recorder decoder.  Decodes the event snapshot saved to the
+    EEPROM after a watchdog or brown-out reset or an explicit trigger.
+    Read the EEPROM back as a raw binary file first, for example:
+
+        avrdude -p m168 -c <programmer> -U eeprom:r:tablebot.eep:r
+
+    usage: tbrec file
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../recorder.h"
+#include "../states.h"
+
+static const char* tablebot_states[] =
+{
+    "SEARCH", "PUSH", "ROTATE", "BACKAWAY", "TURNAWAY", "LOW_BATTERY", "AVOID"
+};
+
+static const char* camera_states[] =
+{
+    "PING", "PING_ACK", "ENABLE_TRACKING", "ENABLE_TRACKING_ACK", "TRACKING", "TRACKING_PACKET",
+    "RESYNC", "RESYNC_ACK", "FILTER", "BAUD", "BAUD_VERIFY"
+};
+
+#define STATE_NAME(names, state) (((state) < sizeof(names) / sizeof(names[0])) ? names[state] : "?")
+
+static void cause_print(uint8_t cause)
+// Print the cause of the snapshot.
+{
+    if (cause & RECORDER_CAUSE_EXPLICIT) printf("explicit (%u)", cause & ~RECORDER_CAUSE_EXPLICIT);
+    else
+    {
+        if (cause & 0x08) printf("watchdog ");
+        if (cause & 0x04) printf("brown-out ");
+        if (cause & 0x02) printf("external ");
+        if (cause & 0x01) printf("power-on ");
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    uint8_t header[RECORDER_HEADER_LENGTH];
+    uint8_t events[256][4];
+    unsigned ticks_high = 0;
+    unsigned count;
+    unsigned i;
+    FILE* fp;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s file\n", argv[0]);
+        return 2;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (!fp)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Read the header.
+    if ((fread(header, 1, sizeof(header), fp) != sizeof(header)) ||
+        ((header[RECORDER_HEADER_MAGIC] | (header[RECORDER_HEADER_MAGIC + 1] << 8)) != RECORDER_EEPROM_MAGIC))
+    {
+        fprintf(stderr, "%s: no flight recorder snapshot\n", argv[1]);
+        return 1;
+    }
+
+    count = header[RECORDER_HEADER_COUNT];
+    if (count > 256) count = 256;
+    count = fread(events, 4, count, fp);
+    fclose(fp);
+
+    printf("snapshot at %.2f s, cause ", (header[RECORDER_HEADER_TICKS] | (header[RECORDER_HEADER_TICKS + 1] << 8)) / 100.0);
+    cause_print(header[RECORDER_HEADER_CAUSE]);
+    printf(", %u events\n", count);
+
+    // Events before the first time event share the high byte it replaced.
+    for (i = 0; i < count; ++i)
+    {
+        if (events[i][0] == RECORDER_TIME)
+        {
+            ticks_high = events[i][3];
+            break;
+        }
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        uint8_t type = events[i][0];
+        uint8_t a = events[i][2];
+        uint8_t b = events[i][3];
+
+        if (type == RECORDER_TIME) ticks_high = a;
+
+        printf("%8.2f  ", ((ticks_high << 8) | events[i][1]) / 100.0);
+
+        switch (type)
+        {
+            case RECORDER_TIME: printf("time\n"); break;
+            case RECORDER_RESET: printf("reset  flags %02x\n", a); break;
+            case RECORDER_TABLEBOT: printf("tablebot  %s\n", STATE_NAME(tablebot_states, a)); break;
+            case RECORDER_CAMERA: printf("camera  %s\n", STATE_NAME(camera_states, a)); break;
+            case RECORDER_SENSORS: printf("sensors  %02x  changed %02x\n", a, b); break;
+            case RECORDER_REFLEX: printf("reflex  %02x\n", a); break;
+            case RECORDER_PACKET: printf("packet  blob x %u size %u\n", a, b); break;
+            case RECORDER_TIMEOUT: printf("camera timeout\n"); break;
+            case RECORDER_PWM_A: printf("pwm a  %u\n", a | (b << 8)); break;
+            case RECORDER_PWM_B: printf("pwm b  %u\n", a | (b << 8)); break;
+            case RECORDER_RESYNC: printf("camera resync\n"); break;
+            case RECORDER_FIRST_BLOB: printf("first blob at %.2f s\n", (a | (b << 8)) / 100.0); break;
+            case RECORDER_BAUD: printf("baud rate %u %s\n", a, b ? "in use" : "failed"); break;
+            case RECORDER_RECOVER: printf("camera recovered in %.2f s\n", (a | (b << 8)) / 100.0); break;
+            default: printf("unknown %u  %02x %02x\n", type, a, b); break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+/*
+    Telemetry decoder.  Reads the COBS framed telemetry stream from the
+    robot's PD7 soft UART through a serial adapter, or from a file of
+    captured bytes, and prints one line per record.
+
+    usage: tbtelem [-b baud] [device|file]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "../telemetry.h"
+#include "../states.h"
+
+static const char* tablebot_states[] =
+{
+    "SEARCH", "PUSH", "ROTATE", "BACKAWAY", "TURNAWAY", "LOW_BATTERY", "AVOID"
+};
+
+static const char* camera_states[] =
+{
+    "PING", "PING_ACK", "ENABLE_TRACKING", "ENABLE_TRACKING_ACK", "TRACKING", "TRACKING_PACKET",
+    "RESYNC", "RESYNC_ACK", "FILTER", "BAUD", "BAUD_VERIFY"
+};
+
+static unsigned long frames_bad;
+
+static const char* state_name(const char** names, unsigned count, uint8_t state)
+// Return the name of the state.
+{
+    return (state < count) ? names[state] : "?";
+}
+
+
+static uint16_t get_u16(const uint8_t* record, int index)
+// Return the little endian 16-bit value.
+{
+    return (uint16_t) (record[index] | (record[index + 1] << 8));
+}
+
+
+static void record_print(const uint8_t* record, int length)
+// Print a decoded record.
+{
+    if ((record[0] == TELEMETRY_RECORD_STATUS) && (length >= TELEMETRY_STATUS_LENGTH))
+    {
+        printf("seq %3u  t %7.2f  %-11s %-19s  sensors %02x  blob %3u @ %3u,%3u  pwm %4d %4d  batt %5u mV  dropped %u  link %5u B/s %2u pkt/s %4.1f B/pkt  recover %.2f s  first blob %.2f s  resyncs %u  confidence %u  stack %u\n",
+               record[TELEMETRY_STATUS_SEQUENCE],
+               get_u16(record, TELEMETRY_STATUS_TICKS) / 100.0,
+               state_name(tablebot_states, sizeof(tablebot_states) / sizeof(tablebot_states[0]), record[TELEMETRY_STATUS_TABLEBOT]),
+               state_name(camera_states, sizeof(camera_states) / sizeof(camera_states[0]), record[TELEMETRY_STATUS_CAMERA]),
+               record[TELEMETRY_STATUS_SENSORS],
+               get_u16(record, TELEMETRY_STATUS_BLOB_SIZE),
+               record[TELEMETRY_STATUS_BLOB_X],
+               record[TELEMETRY_STATUS_BLOB_Y],
+               (int16_t) get_u16(record, TELEMETRY_STATUS_PWM_A),
+               (int16_t) get_u16(record, TELEMETRY_STATUS_PWM_B),
+               get_u16(record, TELEMETRY_STATUS_BATTERY),
+               record[TELEMETRY_STATUS_DROPPED],
+               get_u16(record, TELEMETRY_STATUS_LINK_BYTES),
+               record[TELEMETRY_STATUS_LINK_RATE],
+               record[TELEMETRY_STATUS_LINK_RATE] ? (double) get_u16(record, TELEMETRY_STATUS_LINK_BYTES) / record[TELEMETRY_STATUS_LINK_RATE] : 0.0,
+               get_u16(record, TELEMETRY_STATUS_RECOVER) / 100.0,
+               get_u16(record, TELEMETRY_STATUS_FIRST_BLOB) / 100.0,
+               record[TELEMETRY_STATUS_RESYNCS],
+               record[TELEMETRY_STATUS_CONFIDENCE],
+               get_u16(record, TELEMETRY_STATUS_STACK));
+    }
+    else
+    {
+        printf("record type %u length %d\n", record[0], length);
+    }
+
+    fflush(stdout);
+}
+
+
+static void frame_decode(const uint8_t* frame, int length)
+// Undo the byte stuffing of a frame, check the checksum and print it.
+{
+    uint8_t record[256];
+    uint8_t checksum = 0;
+    int count = 0;
+    int i = 0;
+    int j;
+
+    while (i < length)
+    {
+        int code = frame[i++];
+
+        // A code runs past the end of the frame.
+        if ((code == 0) || (i + code - 1 > length))
+        {
+            ++frames_bad;
+            return;
+        }
+
+        // Copy the block and restore the zero that ended it.
+        for (j = 1; j < code; ++j) record[count++] = frame[i++];
+        if ((code < 0xFF) && (i < length)) record[count++] = 0;
+    }
+
+    // The record bytes and checksum sum to zero.
+    for (j = 0; j < count; ++j) checksum += record[j];
+    if ((count < 2) || checksum)
+    {
+        ++frames_bad;
+        return;
+    }
+
+    record_print(record, count - 1);
+}
+
+
+static speed_t baud_speed(long baud)
+// Return the termios speed for the baud rate.
+{
+    switch (baud)
+    {
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        default: return 0;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    uint8_t frame[256];
+    uint8_t buffer[256];
+    long baud = TELEMETRY_BAUD;
+    int frame_length = 0;
+    int fd = 0;
+    int opt;
+    ssize_t n;
+    ssize_t i;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1)
+    {
+        if (opt == 'b') baud = strtol(optarg, NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [-b baud] [device|file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Open the serial device or capture file.
+    if (optind < argc)
+    {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if (fd < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    // Configure a serial device for raw input at the telemetry baud rate.
+    if (isatty(fd))
+    {
+        struct termios tio;
+
+        if (!baud_speed(baud))
+        {
+            fprintf(stderr, "unsupported baud rate %ld\n", baud);
+            return 2;
+        }
+
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud_speed(baud));
+        cfsetospeed(&tio, baud_speed(baud));
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    // Split the stream into frames on the zero delimiter.
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            if (buffer[i] == 0)
+            {
+                if (frame_length) frame_decode(frame, frame_length);
+                frame_length = 0;
+            }
+            else if (frame_length < (int) sizeof(frame))
+            {
+                frame[frame_length++] = buffer[i];
+            }
+        }
+    }
+
+    if (frames_bad) fprintf(stderr, "%lu bad frames\n", frames_bad);
+
+    return 0;
+}
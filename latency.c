@@ -0,0 +1,128 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "clock.h"
+#include "timer.h"
+#include "latency.h"
+
+#if LATENCY_ENABLE
+
+// Histograms and the longest span of each.
+static uint16_t latency_histogram[LATENCY_HISTOGRAMS][LATENCY_BINS];
+static uint8_t latency_longest[LATENCY_HISTOGRAMS];
+
+void latency_init(void)
+{
+    // Clear the histograms.
+    latency_clear();
+}
+
+
+void latency_record(uint8_t histogram, uint8_t start)
+// Record the span from the start count to now.  Must be called with
+// interrupts disabled.
+{
+    uint8_t now;
+    uint8_t span;
+
+    // Get the span allowing for the timer clearing on compare match.
+    now = TCNT0;
+    span = (now >= start) ? now - start : now + LATENCY_TICK_COUNTS - start;
+
+    // Note the longest span.
+    if (span > latency_longest[histogram]) latency_longest[histogram] = span;
+
+    // Count the span in its bin without wrapping.
+    if (span > (LATENCY_BINS - 1)) span = LATENCY_BINS - 1;
+    if (latency_histogram[histogram][span] != 0xFFFF) ++latency_histogram[histogram][span];
+}
+
+
+void latency_clear(void)
+// Clear the histograms.
+{
+    uint8_t sreg;
+    uint8_t i;
+    uint8_t j;
+
+    // Disable interrupts, which may not be enabled yet.
+    sreg = SREG;
+    cli();
+
+    for (i = 0; i < LATENCY_HISTOGRAMS; ++i)
+    {
+        for (j = 0; j < LATENCY_BINS; ++j) latency_histogram[i][j] = 0;
+        latency_longest[i] = 0;
+    }
+
+    // Restore the interrupt state.
+    SREG = sreg;
+}
+
+
+uint16_t latency_count(uint8_t histogram, uint8_t bin)
+// Return the count in a histogram bin.
+{
+    uint8_t sreg;
+    uint16_t count;
+
+    // Disable interrupts while the 16-bit count is read.
+    sreg = SREG;
+    cli();
+
+    count = latency_histogram[histogram][bin];
+
+    // Restore the interrupt state.
+    SREG = sreg;
+
+    return count;
+}
+
+
+uint8_t latency_max(uint8_t histogram)
+// Return the longest span in a histogram in Timer0 counts.
+{
+    return latency_longest[histogram];
+}
+
+
+uint8_t latency_recv_safe(uint32_t baud)
+// Returns 1 if the longest delay of a receive interrupt seen so far is
+// less than two byte times at the baud rate, otherwise 0.  The USART
+// holds two received bytes while a third is shifted in so such a delay
+// never overruns.  A receive interrupt can wait for the longest span with
+// interrupts disabled and then the Timer0 handler, each measured to the
+// next Timer0 count.
+{
+    uint32_t delay;
+
+    delay = (uint32_t) latency_longest[LATENCY_BLOCKED] + latency_longest[LATENCY_TIMER_RUN] + 2;
+
+    return (delay * baud < 20UL * TIMER_COUNTS_PER_SECOND) ? 1 : 0;
+}
+
+#endif // LATENCY_ENABLE
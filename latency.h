@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#ifndef _TB_LATENCY_H_
+#define _TB_LATENCY_H_ 1
+
+// Interrupt latency instrumentation.  When enabled the time from the
+// Timer0 compare match to its handler, the time spent in the handler and
+// the spans with interrupts disabled in main loop code are kept as
+// histograms in Timer0 counts of 64 us.  Off by default as the
+// histograms and the timing cost RAM and cycles.
+#ifndef LATENCY_ENABLE
+#define LATENCY_ENABLE          0
+#endif
+
+// Histograms.
+#define LATENCY_TIMER           0               // Timer0 compare match to handler entry.
+#define LATENCY_TIMER_RUN       1               // Time in the Timer0 handler.
+#define LATENCY_BLOCKED         2               // Interrupts disabled in main loop code.
+#define LATENCY_HISTOGRAMS      3
+
+// Histogram bins.  Bin n counts spans of n Timer0 counts and the last bin
+// counts the longer spans.
+#define LATENCY_BINS            8
+
+// Timer0 counts per tick.  Timer0 clears on compare match so spans
+// longer than a tick can not be measured.
+#define LATENCY_TICK_COUNTS     157
+
+#if LATENCY_ENABLE
+
+void latency_init(void);
+void latency_record(uint8_t histogram, uint8_t start);
+void latency_clear(void);
+uint16_t latency_count(uint8_t histogram, uint8_t bin);
+uint8_t latency_max(uint8_t histogram);
+uint8_t latency_recv_safe(uint32_t baud);
+
+// Disable interrupts and note the time in the caller's stamp.  Each
+// section keeps its own stamp so a nested section, such as a recorder
+// event while the motor PWM is written, leaves the outer one intact.
+#define LATENCY_CLI(stamp)      do { cli(); (stamp) = TCNT0; } while (0)
+
+// Record the span with interrupts disabled and enable interrupts.
+#define LATENCY_SEI(stamp)      do { latency_record(LATENCY_BLOCKED, (stamp)); sei(); } while (0)
+
+// Restore the interrupt state saved from SREG, recording the span if
+// interrupts were enabled before.
+#define LATENCY_RESTORE(sreg, stamp)    do { if ((sreg) & (1<<SREG_I)) latency_record(LATENCY_BLOCKED, (stamp)); \
+                                             SREG = (sreg); } while (0)
+
+#else
+
+#define latency_init()          ((void) 0)
+#define LATENCY_CLI(stamp)      do { cli(); (stamp) = 0; } while (0)
+#define LATENCY_SEI(stamp)      do { (void) (stamp); sei(); } while (0)
+#define LATENCY_RESTORE(sreg, stamp)    do { (void) (stamp); SREG = (sreg); } while (0)
+
+#endif // LATENCY_ENABLE
+
+#endif // _TB_LATENCY_H_
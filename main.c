@@ -26,33 +26,260 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/wdt.h>
 #include <string.h>
+#include "clock.h"
 #include "fsm.h"
 #include "leds.h"
 #include "motors.h"
 #include "timer.h"
 #include "sensors.h"
 #include "usart.h"
+#include "adc.h"
+#include "battery.h"
+#include "telemetry.h"
+#include "states.h"
+#include "recorder.h"
+#include "watchdog.h"
+#include "latency.h"
+#include "profile.h"
+#include "stack.h"
+#include "sched.h"
+
+// Behavior tunables.  Each is a constant on the robot, but a host build
+// may define TABLEBOT_TUNABLE() to read them from variables instead,
+// which is how host/tbtune searches for better values.
+#ifndef TABLEBOT_TUNABLE
+#define TABLEBOT_TUNABLE(name, value)   (value)
+#endif
+
+// Speed for cruising, rotating, turning and backing away.
+#define TABLEBOT_CRUISE_PWM     TABLEBOT_TUNABLE(CRUISE_PWM, 32)
+
+// Time in 1/10ths of a second to rotate looking for the blob and to turn
+// away from an obstruction.
+#define TABLEBOT_ROTATE_TIME    TABLEBOT_TUNABLE(ROTATE_TIME, 40)
+#define TABLEBOT_TURNAWAY_TIME  TABLEBOT_TUNABLE(TURNAWAY_TIME, 10)
+
+// Search forward for the shortest time plus zero to seven random steps,
+// in 1/10ths of a second, before rotating to look for the blob.
+#define TABLEBOT_SEARCH_TIME    TABLEBOT_TUNABLE(SEARCH_TIME, 50)
+#define TABLEBOT_SEARCH_STEP    TABLEBOT_TUNABLE(SEARCH_STEP, 16)
+
+// Pixels either side of the image center where the blob is dead ahead.
+#define DISPLAY_DEADBAND    TABLEBOT_TUNABLE(DEADBAND, 10)
 
 #define DISPLAY_WIDTH       176
 #define DISPLAY_HEIGHT      144
-#define DISPLAY_LEFT_SIDE   ((DISPLAY_WIDTH / 2) - 10)
-#define DISPLAY_RIGHT_SIDE   ((DISPLAY_WIDTH / 2) + 10)
-
-// This is the color index we are looking for.
-#define BLOB_COLOR          0
+#define DISPLAY_LEFT_SIDE   ((DISPLAY_WIDTH / 2) - DISPLAY_DEADBAND)
+#define DISPLAY_RIGHT_SIDE   ((DISPLAY_WIDTH / 2) + DISPLAY_DEADBAND)
+
+// Front proximity readings where the robot starts to slow down and where
+// it has stopped.  The readings rise as an obstruction gets closer.
+#define PROXIMITY_FAR       200
+#define PROXIMITY_NEAR      600
+
+// Consecutive .2 second tracking timeouts before the camera link is
+// considered stalled and a resynchronization is attempted.
+#define CAMERA_STALL_TIMEOUTS   3
+
+// Shortest and longest wait in 1/100ths of a second for the camera to
+// reply to a command.  The wait doubles each time the camera fails to
+// reply and returns to the shortest once it does.
+#define CAMERA_BACKOFF_MIN      5
+#define CAMERA_BACKOFF_MAX      100
+
+// Camera command replies.
+#define CAMERA_REPLY_NONE       0
+#define CAMERA_REPLY_ACK        1
+#define CAMERA_REPLY_NCK        2
+
+// Optional camera commands which shrink the tracking stream.  The stock
+// AVRcam streams boxes for every color in its color map over the whole
+// image, so these are left undefined unless the camera firmware supports
+// them.  CAMERA_FILTER_COMMAND streams only the boxes of colors with
+// non-zero BLOB_WEIGHTS, for example "CF 0\r".  CAMERA_ROI_COMMAND prefixes a region of interest
+// "ulx uly lrx lry\r" which follows the last fix, for example "RI".
+// #define CAMERA_FILTER_COMMAND   "CF 0\r"
+// #define CAMERA_ROI_COMMAND      "RI"
+
+// Faster baud rates tried with the camera, fastest first, once the
+// handshake succeeds at USART_BAUD.  These are exact at 16 MHz and must
+// be plain numbers as they are also sent as text.  CAMERA_BAUD_COMMAND
+// prefixes the new rate, for example "BR" sends "BR 500000\r".  The
+// camera must acknowledge at the old rate and return to it if the ping
+// at the new rate does not arrive.  The stock AVRcam has no such command
+// so it is left undefined.
+// #define CAMERA_BAUD_COMMAND     "BR"
+#define CAMERA_BAUD_1           1000000
+#define CAMERA_BAUD_2           500000
+#define CAMERA_BAUD_3           250000
+#define CAMERA_BAUD_COUNT       4
+
+// Receive errors in a second which cause a slower baud rate.
+#define CAMERA_BAUD_ERRORS      4
+
+#if USART_ERROR_PERMILLE(CAMERA_BAUD_1) > USART_ERROR_MAX_PERMILLE
+#error "CAMERA_BAUD_1 can not be generated accurately from FOSC"
+#endif
+#if USART_ERROR_PERMILLE(CAMERA_BAUD_2) > USART_ERROR_MAX_PERMILLE
+#error "CAMERA_BAUD_2 can not be generated accurately from FOSC"
+#endif
+#if USART_ERROR_PERMILLE(CAMERA_BAUD_3) > USART_ERROR_MAX_PERMILLE
+#error "CAMERA_BAUD_3 can not be generated accurately from FOSC"
+#endif
+
+#define CAMERA_BAUD_STRING_(baud)   #baud
+#define CAMERA_BAUD_STRING(baud)    CAMERA_BAUD_STRING_(baud)
+
+// Margin around the last fix kept in the region of interest.
+#define CAMERA_ROI_MARGIN       16
+
+// Number of color indexes reported by the camera.
+#define CAMERA_COLORS       8
+
+// Most boxes the camera reports in a tracking packet.  A packet is the
+// 0x0A header, the box count, five bytes per box and the 0xFF trailer.
+#define CAMERA_MAX_BOXES    8
+#define CAMERA_PACKET_SIZE  (3 + (5 * CAMERA_MAX_BOXES))
+
+// Camera packet framing states.
+#define CAMERA_FRAME_HUNT   0           // Looking for the header.
+#define CAMERA_FRAME_COUNT  1           // Expecting the box count.
+#define CAMERA_FRAME_BOXES  2           // Expecting box bytes.
+#define CAMERA_FRAME_END    3           // Expecting the trailer.
+
+// Weight of each color index when picking a target.  Colors with positive
+// weights are chased and those with negative weights avoided.  The box
+// with the largest weight times size wins.  For example, to chase red
+// blocks (color 0) and avoid blue markers (color 2):
+// #define BLOB_WEIGHTS     { 4, 0, -1, 0, 0, 0, 0, 0 }
+#ifndef BLOB_WEIGHTS
+#define BLOB_WEIGHTS        { 1, 0, 0, 0, 0, 0, 0, 0 }
+#endif
+
+// Size at which an avoided color is close enough to turn away from.
+#define AVOID_SIZE          40
+
+// Smallest box area and largest ratio of the long side to the short side
+// of a box taken as an object rather than noise.
+#define BLOB_MIN_AREA       9
+#define BLOB_MAX_ASPECT     4
+
+// Target confidence.  Each packet with the target raises it by HIT and
+// each packet without lowers it by MISS.  A tracking timeout lowers it by
+// TIMEOUT.  The target is reported once confidence reaches ACQUIRE and
+// held at its last position until confidence drops below LOSE.
+#define BLOB_CONFIDENCE_MAX         12
+#define BLOB_CONFIDENCE_HIT         3
+#define BLOB_CONFIDENCE_MISS        1
+#define BLOB_CONFIDENCE_TIMEOUT     3
+#define BLOB_CONFIDENCE_ACQUIRE     6
+#define BLOB_CONFIDENCE_LOSE        3
 
 // Blob tracking information.
 static uint16_t blob_size;
 static uint8_t blob_center_x;
 static uint8_t blob_center_y;
+static uint8_t blob_confidence;
+static uint8_t blob_tracked;
+
+// Avoided marker information.
+static uint16_t avoid_size;
+static uint8_t avoid_center_x;
+
+// Largest box of each color from the last packet.
+static const int8_t color_weight[CAMERA_COLORS] = BLOB_WEIGHTS;
+static uint16_t color_size[CAMERA_COLORS];
+static uint8_t color_center_x[CAMERA_COLORS];
+static uint8_t color_center_y[CAMERA_COLORS];
+
+// State machine states reported by telemetry, none until each first runs.
+static uint8_t tablebot_state = 0xFF;
+static uint8_t camera_state = 0xFF;
+static uint8_t camera_state_recorded = 0xFF;
 
 // Camera packet information.
 static char camera_ack[8];
-static char camera_packet[64];
+static uint8_t camera_packet[CAMERA_PACKET_SIZE];
 static uint8_t camera_packet_len = 0;
+
+// Camera packet framing information.
+static uint8_t camera_frame_state = CAMERA_FRAME_HUNT;
+static uint8_t camera_frame_end;            // Length when the boxes are done.
+static uint8_t camera_frame_box;            // Bytes of the current box so far.
+static uint8_t camera_resyncs;              // Corrupt packets resynchronized.
 static uint8_t camera_packet_num = 0;
 
+// Camera command information.
+static uint8_t camera_reply;                // Last reply read.
+static uint8_t camera_replies;              // Replies counted so far.
+static uint8_t camera_backoff = CAMERA_BACKOFF_MIN;
+static uint16_t camera_deadline;            // Ticks when the reply wait is over.
+static uint16_t camera_first_blob;          // Ticks from boot to the first blob.
+
+#ifdef CAMERA_BAUD_COMMAND
+// Camera baud rates, fastest first and ending with the boot rate.
+static const uint16_t camera_baud_ubrr[CAMERA_BAUD_COUNT] =
+{
+    USART_UBRR(CAMERA_BAUD_1), USART_UBRR(CAMERA_BAUD_2),
+    USART_UBRR(CAMERA_BAUD_3), USART_UBRR(USART_BAUD)
+};
+static char *camera_baud_command[CAMERA_BAUD_COUNT] =
+{
+    CAMERA_BAUD_COMMAND " " CAMERA_BAUD_STRING(CAMERA_BAUD_1) "\r",
+    CAMERA_BAUD_COMMAND " " CAMERA_BAUD_STRING(CAMERA_BAUD_2) "\r",
+    CAMERA_BAUD_COMMAND " " CAMERA_BAUD_STRING(CAMERA_BAUD_3) "\r",
+    CAMERA_BAUD_COMMAND " " CAMERA_BAUD_STRING(USART_BAUD) "\r"
+};
+
+// Camera baud rate information.
+static uint8_t camera_baud = CAMERA_BAUD_COUNT - 1;    // Rate in use.
+static uint8_t camera_baud_target = 0;                 // Rate to negotiate.
+static uint16_t camera_link_errors;                     // Errors at the last sample.
+static uint8_t camera_link_noisy;                       // Too many errors last second.
+#endif
+
+#ifdef CAMERA_ROI_COMMAND
+// Current camera region of interest.
+static uint8_t camera_roi[4];
+#endif
+
+// Camera link watchdog information.
+static uint16_t camera_link_recv;           // Receive count at the last sample.
+static uint16_t camera_link_bytes;          // Bytes received in the last second.
+static uint8_t camera_link_packets;         // Packets received in the last second.
+static uint8_t camera_link_count;           // Packets received this second.
+static uint8_t camera_timeouts;             // Consecutive tracking timeouts.
+static uint8_t camera_stalled;              // Set while recovering from a stall.
+static uint16_t camera_stall_ticks;         // Ticks when the stall was detected.
+static uint16_t camera_recover_ticks;       // Ticks taken by the last recovery.
+
+void tablebot_state_set(uint8_t state)
+// Report the TableBot state on entry to each state.  Only a change is
+// recorded so states entered on every tick don't flush the ring.
+{
+    if (state == tablebot_state) return;
+
+    tablebot_state = state;
+    recorder_event(RECORDER_TABLEBOT, state, 0);
+}
+
+
+void camera_state_set(uint8_t state)
+// Report the camera state on entry to each state.  Only a change is
+// recorded.  Each packet has its own event so the packet state is left
+// out and going back to tracking after a packet is not a change.
+{
+    camera_state = state;
+
+    if ((state == CAMERA_STATE_TRACKING_PACKET) || (state == camera_state_recorded)) return;
+
+    camera_state_recorded = state;
+    recorder_event(RECORDER_CAMERA, state, 0);
+}
+
+
 void motors_stop(void)
 {
     // Stop the motors.
@@ -77,28 +304,265 @@ void motors_rotate(int16_t a_pwm, int16_t b_pwm)
 }
 
 
+void camera_wait_set(void)
+// Start waiting for a camera reply.  The next wait is twice as long in
+// case this one runs out.
+{
+    // Set the deadline.
+    camera_deadline = timer_get_ticks() + camera_backoff;
+
+    // Back off up to the longest wait.
+    camera_backoff = (camera_backoff >= (CAMERA_BACKOFF_MAX / 2)) ? CAMERA_BACKOFF_MAX : (camera_backoff << 1);
+}
+
+
+uint8_t camera_reply_read(void)
+// Read a reply line from the camera.  Anything other than an ACK or
+// NCK, such as the tail of a tracking packet, is ignored.
+{
+    uint8_t len;
+
+    // Is there a complete line to read?
+    if (!usart_recv_buffer_has_eol('\r')) return CAMERA_REPLY_NONE;
+
+    // Read the line.
+    len = usart_recv_buffer(camera_ack, 8, '\r');
+
+    // The reply is at the end of the line.
+    if ((len < 4) || (camera_ack[len - 1] != '\r')) return CAMERA_REPLY_NONE;
+    if (!strncmp(camera_ack + len - 4, "ACK\r", 4)) return CAMERA_REPLY_ACK;
+    if (!strncmp(camera_ack + len - 4, "NCK\r", 4)) return CAMERA_REPLY_NCK;
+
+    return CAMERA_REPLY_NONE;
+}
+
+
+uint8_t camera_reply_ready(void)
+// Returns 1 once there is a reply line to read or the wait for it is
+// over.  Until then the reply states have nothing to do.
+{
+    return (usart_recv_buffer_has_eol('\r') || timer_ticks_passed(camera_deadline)) ? 1 : 0;
+}
+
+
+#ifdef CAMERA_ROI_COMMAND
+// Longest region of interest command.  The command and a space, four
+// values of up to three digits each followed by a space or the final
+// carriage return, and the terminator.
+#define CAMERA_ROI_LENGTH       (sizeof(CAMERA_ROI_COMMAND) + 4 * 4 + 1)
+
+// The command must fit the transmit buffer or it is never sent.  The
+// array size goes negative, failing the build, if it doesn't.
+typedef char camera_roi_fits[((CAMERA_ROI_LENGTH - 1) <= USART_XMIT_BUFFER_SIZE) ? 1 : -1];
+
+char *camera_put_uint8(char *p, uint8_t value)
+// Format a value in decimal followed by a space.
+{
+    // Hundreds and tens are only sent when needed.
+    if (value >= 100) *p++ = '0' + (value / 100);
+    if (value >= 10) *p++ = '0' + ((value / 10) % 10);
+    *p++ = '0' + (value % 10);
+    *p++ = ' ';
+
+    return p;
+}
+
+
+void camera_roi_set(uint8_t ulx, uint8_t uly, uint8_t lrx, uint8_t lry)
+// Send a new region of interest to the camera if it changed.  The reply
+// is not waited for and is skipped with the next tracking packet.
+{
+    char command[CAMERA_ROI_LENGTH];
+    char *p;
+
+    // Nothing to do if the region is unchanged.
+    if ((camera_roi[0] == ulx) && (camera_roi[1] == uly) &&
+        (camera_roi[2] == lrx) && (camera_roi[3] == lry)) return;
+
+    // Build the command.
+    strcpy(command, CAMERA_ROI_COMMAND " ");
+    p = command + strlen(command);
+    p = camera_put_uint8(p, ulx);
+    p = camera_put_uint8(p, uly);
+    p = camera_put_uint8(p, lrx);
+    p = camera_put_uint8(p, lry);
+    p[-1] = '\r';
+
+    // Only remember the region once the command is on its way.
+    if (!usart_xmit_buffer(command, p - command)) return;
+
+    camera_roi[0] = ulx;
+    camera_roi[1] = uly;
+    camera_roi[2] = lrx;
+    camera_roi[3] = lry;
+}
+
+
+void camera_roi_update(void)
+// Keep the region of interest around the last fix, or the whole image
+// when there is no fix.
+{
+    uint8_t extent;
+
+    // Look at the whole image without a fix.
+    if (!blob_size)
+    {
+        camera_roi_set(0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+        return;
+    }
+
+    // The box width and height are each no more than the blob size so a
+    // square of half the size around the center contains it.
+    extent = (blob_size >> 1) + CAMERA_ROI_MARGIN;
+
+    // Clip the region to the image.
+    camera_roi_set((blob_center_x > extent) ? blob_center_x - extent : 0,
+                   (blob_center_y > extent) ? blob_center_y - extent : 0,
+                   (blob_center_x + extent < DISPLAY_WIDTH) ? blob_center_x + extent : DISPLAY_WIDTH - 1,
+                   (blob_center_y + extent < DISPLAY_HEIGHT) ? blob_center_y + extent : DISPLAY_HEIGHT - 1);
+}
+#endif
+
+
+void camera_link_update(void)
+// Sample the camera link throughput.  Called once a second.
+{
+    uint16_t recv = usart_recv_count();
+
+    // Bytes and packets received over the last second.
+    camera_link_bytes = recv - camera_link_recv;
+    camera_link_packets = camera_link_count;
+
+    // Start the next second.
+    camera_link_recv = recv;
+    camera_link_count = 0;
+
+#ifdef CAMERA_BAUD_COMMAND
+    // Note a noisy link so a slower rate is negotiated.
+    recv = usart_recv_errors();
+    if ((uint16_t) (recv - camera_link_errors) > CAMERA_BAUD_ERRORS) camera_link_noisy = 1;
+    camera_link_errors = recv;
+#endif
+}
+
+
+#ifdef CAMERA_BAUD_COMMAND
+uint8_t camera_baud_slower(void)
+// Target the next slower baud rate.  Returns 1 if there is one.
+{
+    if (camera_baud_target >= (CAMERA_BAUD_COUNT - 1)) return 0;
+
+    ++camera_baud_target;
+
+    return 1;
+}
+
+
+uint8_t camera_baud_noisy(void)
+// Returns 1 if the link is too noisy at the current rate and a slower
+// one should be negotiated.
+{
+    // Is the link noisy at a fast rate?
+    if (!camera_link_noisy) return 0;
+    camera_link_noisy = 0;
+
+    // Target the next slower rate.
+    camera_baud_target = camera_baud;
+    return camera_baud_slower();
+}
+
+
+void camera_baud_reset(void)
+// Return to the boot rate in case the camera was reset.  The rate in use
+// is negotiated again once the camera replies.
+{
+    // Nothing to do at the boot rate.
+    if (camera_baud == (CAMERA_BAUD_COUNT - 1)) return;
+
+    camera_baud_target = camera_baud;
+    camera_baud = CAMERA_BAUD_COUNT - 1;
+    usart_set_baud(camera_baud_ubrr[camera_baud]);
+}
+#endif
+
+
+void camera_link_stall(void)
+// Note the camera link has stalled and start timing the recovery.
+{
+    // Only the first detection starts the recovery time.
+    if (!camera_stalled)
+    {
+        camera_stalled = 1;
+        camera_stall_ticks = timer_get_ticks();
+    }
+
+    // Record the stall.
+    recorder_event(RECORDER_RESYNC, camera_timeouts, 0);
+}
+
+
+void camera_link_packet(void)
+// Note a camera packet arrived and finish timing any recovery.
+{
+    // Count the packet.
+    ++camera_link_count;
+    camera_timeouts = 0;
+
+    // Has the link recovered from a stall?
+    if (camera_stalled)
+    {
+        camera_stalled = 0;
+        camera_recover_ticks = timer_get_ticks() - camera_stall_ticks;
+
+        // Record the recovery time.
+        recorder_event(RECORDER_RECOVER, (uint8_t) camera_recover_ticks, (uint8_t) (camera_recover_ticks >> 8));
+    }
+}
+
+
+int16_t motors_proximity(int16_t pwm)
+// Scale a forward PWM down as the front proximity sensors see an
+// obstruction getting closer so the robot slows gradually to a stop.
+{
+    uint16_t proximity;
+
+    // Use the closest of the two front readings.
+    proximity = adc_get(ADC_LEFT_FRONT);
+    if (adc_get(ADC_RIGHT_FRONT) > proximity) proximity = adc_get(ADC_RIGHT_FRONT);
+
+    // Only forward motion is slowed.
+    if ((pwm <= 0) || (proximity <= PROXIMITY_FAR)) return pwm;
+
+    // Stop when the obstruction is near.
+    if (proximity >= PROXIMITY_NEAR) return 0;
+
+    // Scale linearly between far and near.
+    return (int16_t) (((int32_t) pwm * (PROXIMITY_NEAR - proximity)) / (PROXIMITY_NEAR - PROXIMITY_FAR));
+}
+
+
 void motors_search(void)
 {
     // Default is to keep going forward.
-    int16_t a_pwm = 32;
-    int16_t b_pwm = 32;
+    int16_t a_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
+    int16_t b_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
 
     // Determine adjustment factor.
     if (blob_size && (blob_center_x < DISPLAY_LEFT_SIDE))
     {
         // Turn left.
-        b_pwm -= (DISPLAY_LEFT_SIDE - ((int16_t) blob_center_x));
+        b_pwm -= MOTORS_SPEED(DISPLAY_LEFT_SIDE - ((int16_t) blob_center_x));
 
         // Make sure it is not too much.
-        if (b_pwm < -32) a_pwm = -32;
+        if (b_pwm < MOTORS_SPEED(-TABLEBOT_CRUISE_PWM)) a_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
     }
     else if (blob_size && (blob_center_x > DISPLAY_RIGHT_SIDE))
     {
         // Turn right.
-        a_pwm -= (((int16_t) blob_center_x) - DISPLAY_RIGHT_SIDE);
+        a_pwm -= MOTORS_SPEED(((int16_t) blob_center_x) - DISPLAY_RIGHT_SIDE);
 
         // Make sure it is not too much.
-        if (a_pwm < -32) a_pwm = -32;
+        if (a_pwm < MOTORS_SPEED(-TABLEBOT_CRUISE_PWM)) a_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
     }
 
     // Set the motor PWM values.
@@ -110,35 +574,35 @@ void motors_search(void)
 void motors_turnaway(uint8_t obstruction)
 {
     // Be default turn left.
-    int16_t a_pwm = 32;
-    int16_t b_pwm = -32;
+    int16_t a_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
+    int16_t b_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
 
     // Determine the direction to turn.
     if ((obstruction == (1<<SENSOR_GROUND_LEFT_FRONT)) ||
         (obstruction == ((1<<SENSOR_GROUND_LEFT_FRONT) | (1<<SENSOR_GROUND_FRONT))))
     {
         // Turn right.
-        a_pwm = -32;
-        b_pwm = 32;
+        a_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
     }
     else if ((obstruction == (1<<SENSOR_GROUND_RIGHT_FRONT)) ||
              (obstruction == ((1<<SENSOR_GROUND_RIGHT_FRONT) | (1<<SENSOR_GROUND_FRONT))))
     {
         // Turn left.
-        a_pwm = 32;
-        b_pwm = -32;
+        a_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
     }
     else if (obstruction == (1<<SENSOR_GROUND_RIGHT_REAR))
     {
         // Turn right.
-        a_pwm = -32;
-        b_pwm = 32;
+        a_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
     }
     else if (obstruction == (1<<SENSOR_GROUND_LEFT_REAR))
     {
         // Turn left.
-        a_pwm = 32;
-        b_pwm = -32;
+        a_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
     }
 
     // Set the motor PWM values.
@@ -156,14 +620,14 @@ void motors_backaway(uint8_t obstruction)
     if ((obstruction & SENSORS_FORWARD) && !(obstruction & SENSORS_REARWARD))
     {
         // Reverse slowly.
-        a_pwm = -32;
-        b_pwm = -32;
+        a_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(-TABLEBOT_CRUISE_PWM);
     }
     else if ((obstruction & SENSORS_REARWARD) && !(obstruction & SENSORS_FORWARD))
     {
         // Forward slowly.
-        a_pwm = 32;
-        b_pwm = 32;
+        a_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
+        b_pwm = MOTORS_SPEED(TABLEBOT_CRUISE_PWM);
     }
 
     // Set the motor PWM values.
@@ -181,14 +645,23 @@ int16_t tablebot_fsm()
 
         FSM_STATE_BEGIN(SEARCH)
 
-            // Set motors to go forward.
-            motors_start(32);
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_SEARCH);
 
             // Configure timer to wait a random amount of time.
-            timer_wait_set(0, 50 + ((timer_random() & 0x07) << 4));
+            timer_wait_set(0, TABLEBOT_SEARCH_TIME + ((timer_random() & 0x07) * TABLEBOT_SEARCH_STEP));
 
             fsm_checkpoint();
 
+            // Set motors to go forward, slowing for obstructions ahead.
+            motors_start(motors_proximity(MOTORS_SPEED(TABLEBOT_CRUISE_PWM)));
+
+            // Stop if the battery is low.
+            fsm_change_state(battery_is_low(), LOW_BATTERY);
+
+            // Turn away from markers to avoid.
+            fsm_change_state(avoid_size >= AVOID_SIZE, AVOID);
+
             // Keep an eye out for the blob.
             fsm_change_state(blob_size, PUSH);
 
@@ -202,12 +675,21 @@ int16_t tablebot_fsm()
 
         FSM_STATE_BEGIN(PUSH)
 
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_PUSH);
+
             // Steer towards the block to push it.
             motors_search();
 
             // Back away from obstructions.
             fsm_change_state(sensors_triggered(0), BACKAWAY);
 
+            // Stop if the battery is low.
+            fsm_change_state(battery_is_low(), LOW_BATTERY);
+
+            // Turn away from markers to avoid.
+            fsm_change_state(avoid_size >= AVOID_SIZE, AVOID);
+
             // Rotate if we lost the blob.
             fsm_change_state(!blob_size, ROTATE);
 
@@ -215,6 +697,9 @@ int16_t tablebot_fsm()
 
         FSM_STATE_BEGIN(ROTATE)
 
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_ROTATE);
+
             // Stop the motors.
             motors_stop();
 
@@ -225,10 +710,10 @@ int16_t tablebot_fsm()
             fsm_wait_until(timer_wait_done(0));
 
             // Set time to wait for complete turn.
-            timer_wait_set(0, 40);
+            timer_wait_set(0, TABLEBOT_ROTATE_TIME);
 
             // Set the motors to rotate.
-            motors_rotate(-32, 32);
+            motors_rotate(MOTORS_SPEED(-TABLEBOT_CRUISE_PWM), MOTORS_SPEED(TABLEBOT_CRUISE_PWM));
 
             fsm_checkpoint();
 
@@ -245,11 +730,17 @@ int16_t tablebot_fsm()
 
         FSM_STATE_BEGIN(BACKAWAY)
 
-            // Stop the motors.
-            motors_stop();
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_BACKAWAY);
+
+            // Save the sensor data which indicates the location of the obstruction
+            // and clear any obstruction latched by the sensor reflex.
+            obstruction = sensors_reflex_clear();
+            obstruction |= sensors_triggered(0);
 
-            // Save the sensor data which indicates the location of the obstruction.
-            obstruction = sensors_triggered(0);
+            // Take back control of the motors from the reflex and stop them.
+            motors_reflex_release();
+            motors_stop();
 
             // Set the motor directions to stop.
             motors_backaway(obstruction);
@@ -269,6 +760,9 @@ int16_t tablebot_fsm()
 
         FSM_STATE_BEGIN(TURNAWAY)
 
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_TURNAWAY);
+
             // Stop the motors.
             motors_stop();
 
@@ -285,7 +779,7 @@ int16_t tablebot_fsm()
             motors_turnaway(obstruction);
 
             // Set time to wait for turn to complete.
-            timer_wait_set(0, 10);
+            timer_wait_set(0, TABLEBOT_TURNAWAY_TIME);
 
             fsm_checkpoint();
 
@@ -299,31 +793,291 @@ int16_t tablebot_fsm()
             fsm_change_state(timer_wait_done(0), SEARCH);
         FSM_STATE_END
 
+        FSM_STATE_BEGIN(AVOID)
+
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_AVOID);
+
+            // Turn away from the side the marker is on.
+            motors_turnaway((avoid_center_x < (DISPLAY_WIDTH / 2)) ?
+                            (1<<SENSOR_GROUND_LEFT_FRONT) : (1<<SENSOR_GROUND_RIGHT_FRONT));
+
+            // Set the timer to wait .5 seconds.
+            timer_wait_set(0, 5);
+
+            fsm_checkpoint();
+
+            // Back away from obstructions.
+            fsm_change_state(sensors_triggered(0), BACKAWAY);
+
+            // Resume searching once turned away.
+            fsm_change_state(timer_wait_done(0), SEARCH);
+
+        FSM_STATE_END
+
+        FSM_STATE_BEGIN(LOW_BATTERY)
+
+            // Report the state.
+            tablebot_state_set(TABLEBOT_STATE_LOW_BATTERY);
+
+            // Stop the motors.
+            motors_stop();
+
+            fsm_checkpoint();
+
+            // Back away from obstructions.
+            fsm_change_state(sensors_triggered(0), BACKAWAY);
+
+            // Resume searching once the battery recovers.
+            fsm_change_state(!battery_is_low(), SEARCH);
+
+        FSM_STATE_END
+
     FSM_END
 }
 
 
+void blob_reset(void)
+// Forget the target.
+{
+    blob_size = 0;
+    blob_center_x = 88;
+    blob_center_y = 72;
+}
+
+
+void blob_confidence_change(uint8_t hit, uint8_t amount)
+// Raise or lower the target confidence and acquire or lose the target
+// as it crosses the thresholds.
+{
+    // Adjust the confidence within its range.
+    if (hit)
+        blob_confidence = (blob_confidence > (BLOB_CONFIDENCE_MAX - amount)) ? BLOB_CONFIDENCE_MAX : blob_confidence + amount;
+    else
+        blob_confidence = (blob_confidence > amount) ? blob_confidence - amount : 0;
+
+    // Acquire or lose the target with hysteresis.
+    if (blob_confidence >= BLOB_CONFIDENCE_ACQUIRE) blob_tracked = 1;
+    else if (blob_confidence < BLOB_CONFIDENCE_LOSE) blob_tracked = 0;
+
+    // Forget a lost target.
+    if (!blob_tracked) blob_reset();
+}
+
+
+void blob_timeout(void)
+// Lower the target confidence when no packet arrived in time.
+{
+    // The marker is no longer known.
+    avoid_size = 0;
+
+    // A timeout counts as several misses.
+    blob_confidence_change(0, BLOB_CONFIDENCE_TIMEOUT);
+}
+
+
+void blob_select(void)
+// Pick the target and the marker to avoid from the largest box of each
+// color by the color weights.
+{
+    uint8_t color;
+    uint8_t best_color = 0;
+    uint16_t score;
+    uint16_t best_score = 0;
+
+    // Forget the marker.
+    avoid_size = 0;
+    avoid_center_x = 88;
+
+    // Loop over each color.
+    for (color = 0; color < CAMERA_COLORS; ++color)
+    {
+        // Skip colors which were not seen.
+        if (!color_size[color]) continue;
+
+        if (color_weight[color] > 0)
+        {
+            // Chase the color with the best weighted size.
+            score = color_size[color] * (uint8_t) color_weight[color];
+            if (score > best_score)
+            {
+                best_score = score;
+                best_color = color;
+            }
+        }
+        else if (color_weight[color] < 0)
+        {
+            // Avoid the largest marker.
+            if (color_size[color] > avoid_size)
+            {
+                avoid_size = color_size[color];
+                avoid_center_x = color_center_x[color];
+            }
+        }
+    }
+
+    // Update the confidence with the detection or the miss.
+    blob_confidence_change(best_score ? 1 : 0, best_score ? BLOB_CONFIDENCE_HIT : BLOB_CONFIDENCE_MISS);
+
+    // Follow the target while it is tracked.
+    if (blob_tracked && best_score)
+    {
+        blob_size = color_size[best_color];
+        blob_center_x = color_center_x[best_color];
+        blob_center_y = color_center_y[best_color];
+    }
+}
+
+
+void camera_frame_reset(void)
+// Start looking for a packet header.
+{
+    camera_frame_state = CAMERA_FRAME_HUNT;
+}
+
+
+uint8_t camera_frame_error(uint8_t byte)
+// Drop a corrupt packet and resynchronize on the next header.  The byte
+// which showed the corruption may itself be the next header.
+{
+    // Count the resynchronization.
+    ++camera_resyncs;
+
+    // Start looking for the next header.
+    camera_frame_state = CAMERA_FRAME_HUNT;
+
+    // Is this byte the next header?
+    if (byte == 0x0A)
+    {
+        camera_packet[0] = byte;
+        camera_packet_len = 1;
+        camera_frame_state = CAMERA_FRAME_COUNT;
+    }
+
+    return 0;
+}
+
+
+uint8_t camera_frame(uint8_t byte)
+// Frame the tracking packets in the camera byte stream.  The box count
+// sets the packet length so 0xFF inside a box can not end a packet early.
+// Returns 1 once a complete packet is in camera_packet with a length that
+// matches the box count and every box within the image.
+{
+    uint8_t *box;
+
+    // Look for the header.
+    if (camera_frame_state == CAMERA_FRAME_HUNT)
+    {
+        if (byte == 0x0A)
+        {
+            camera_packet[0] = byte;
+            camera_packet_len = 1;
+            camera_frame_state = CAMERA_FRAME_COUNT;
+        }
+
+        return 0;
+    }
+
+    // Check the trailer.
+    if (camera_frame_state == CAMERA_FRAME_END)
+    {
+        if (byte != 0xFF) return camera_frame_error(byte);
+
+        // The packet is complete.
+        camera_packet[camera_packet_len++] = byte;
+        camera_frame_state = CAMERA_FRAME_HUNT;
+
+        return 1;
+    }
+
+    // Check the box count.
+    if (camera_frame_state == CAMERA_FRAME_COUNT)
+    {
+        if (byte > CAMERA_MAX_BOXES) return camera_frame_error(byte);
+
+        // Note the length once all the boxes are in.
+        camera_packet[camera_packet_len++] = byte;
+        camera_frame_end = 2 + (5 * byte);
+        camera_frame_box = 0;
+        camera_frame_state = byte ? CAMERA_FRAME_BOXES : CAMERA_FRAME_END;
+
+        return 0;
+    }
+
+    // Check each box byte as it arrives so corruption is caught early.
+    // The color comes first followed by the x and y of each corner.
+    if (camera_frame_box == 0)
+    {
+        if (byte >= CAMERA_COLORS) return camera_frame_error(byte);
+    }
+    else if (camera_frame_box & 1)
+    {
+        if (byte >= DISPLAY_WIDTH) return camera_frame_error(byte);
+    }
+    else
+    {
+        if (byte >= DISPLAY_HEIGHT) return camera_frame_error(byte);
+    }
+
+    // Store the box byte.
+    camera_packet[camera_packet_len++] = byte;
+
+    // Wait for the rest of the box.
+    if (++camera_frame_box < 5) return 0;
+    camera_frame_box = 0;
+
+    // Check the lower right corner is not above or left of the upper left.
+    box = camera_packet + camera_packet_len - 5;
+    if ((box[1] > box[3]) || (box[2] > box[4])) return camera_frame_error(byte);
+
+    // Expect the trailer after the last box.
+    if (camera_packet_len == camera_frame_end) camera_frame_state = CAMERA_FRAME_END;
+
+    return 0;
+}
+
+
+uint8_t camera_packet_read(void)
+// Frame the received bytes.  Returns 1 once a packet is complete.  Any
+// bytes after the packet are left in the receive buffer.
+{
+    char buffer[16];
+    uint8_t count;
+    uint8_t i;
+
+    // Read up to and including the next possible trailer.
+    while ((count = usart_recv_buffer(buffer, sizeof(buffer), 0xFF)) != 0)
+    {
+        // Frame each byte.  A packet can only complete on the last byte.
+        for (i = 0; i < count; ++i)
+        {
+            if (camera_frame((uint8_t) buffer[i])) return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 void camera_packet_process(void)
-// Process a camera packet.  We essentially want to get the 
-// largest blob from the packet and update the blob state.
+// Process a camera packet.  We keep the largest box of each color from
+// the packet and then pick the target from them.
 {
     uint8_t i;
     uint8_t boxes;
     uint8_t box_index;
+    uint8_t box_color;
     uint8_t box_upper_left_x;
     uint8_t box_upper_left_y;
     uint8_t box_lower_right_x;
     uint8_t box_lower_right_y;
+    uint8_t box_width;
+    uint8_t box_height;
     uint16_t box_size;
 
-    // Ignore packets that don't look valid.
-    if (camera_packet[0] != 0x0A) return;
-    if (camera_packet[camera_packet_len - 1] != 0xFF) return;
-
-    // Reset the blob information.
-    blob_size = 0;
-    blob_center_x = 88;
-    blob_center_y = 72;
+    // Reset the color information.
+    for (i = 0; i < CAMERA_COLORS; ++i) color_size[i] = 0;
 
     // Get the bounding box count.
     boxes = camera_packet[1];
@@ -334,8 +1088,8 @@ void camera_packet_process(void)
         // Fill in the box index.
         box_index = 2 + (i * 5);
 
-        // Look for the blob color.
-        if (camera_packet[box_index] != BLOB_COLOR) continue;
+        // Get the box color.
+        box_color = camera_packet[box_index];
 
         // Get the bound box.
         box_upper_left_x = camera_packet[box_index + 1];
@@ -343,25 +1097,82 @@ void camera_packet_process(void)
         box_lower_right_x = camera_packet[box_index + 3];
         box_lower_right_y = camera_packet[box_index + 4];
  
+        // Skip boxes too small or too thin to be an object.
+        box_width = box_lower_right_x - box_upper_left_x + 1;
+        box_height = box_lower_right_y - box_upper_left_y + 1;
+        if (((uint16_t) box_width * box_height) < BLOB_MIN_AREA) continue;
+        if ((box_width > (BLOB_MAX_ASPECT * box_height)) ||
+            (box_height > (BLOB_MAX_ASPECT * box_width))) continue;
+
         // Get the box size as the taxi distance around half the box.
         box_size = (box_lower_right_x - box_upper_left_x);
         box_size += (box_lower_right_y - box_upper_left_y);
 
-        // Should we update the blob information.
-        if ((i == 0) || (box_size > blob_size))
+        // Keep the largest box of each color.
+        if (box_size > color_size[box_color])
         {
-            // Fill the new blob information.
-            blob_size = box_size;
-            blob_center_x = (box_lower_right_x >> 1) + (box_upper_left_x >> 1);
-            blob_center_y = (box_lower_right_y >> 1) + (box_upper_left_y >> 1);
+            color_size[box_color] = box_size;
+            color_center_x[box_color] = (box_lower_right_x >> 1) + (box_upper_left_x >> 1);
+            color_center_y[box_color] = (box_lower_right_y >> 1) + (box_upper_left_y >> 1);
         }
     }
 
+    // Pick the target.
+    blob_select();
+
     // Blink the tracking LED while tracking a blob.
     if (blob_size && (++camera_packet_num & 0x02)) leds_yellow_on(); else leds_yellow_off();
 }
 
 
+void tablebot_telemetry(void)
+// Send a telemetry status record.
+{
+    static uint8_t sequence = 0;
+    uint8_t record[TELEMETRY_STATUS_LENGTH];
+    uint16_t ticks = timer_get_ticks();
+    int16_t pwm_a = motors_a_output();
+    int16_t pwm_b = motors_b_output();
+    uint16_t battery = battery_millivolts();
+    uint16_t stack = stack_unused();
+
+    // Fill in the status record.
+    record[TELEMETRY_STATUS_TYPE] = TELEMETRY_RECORD_STATUS;
+    record[TELEMETRY_STATUS_SEQUENCE] = sequence++;
+    record[TELEMETRY_STATUS_TICKS] = (uint8_t) ticks;
+    record[TELEMETRY_STATUS_TICKS + 1] = (uint8_t) (ticks >> 8);
+    record[TELEMETRY_STATUS_TABLEBOT] = tablebot_state;
+    record[TELEMETRY_STATUS_CAMERA] = camera_state;
+    record[TELEMETRY_STATUS_SENSORS] = sensors_get();
+    record[TELEMETRY_STATUS_BLOB_SIZE] = (uint8_t) blob_size;
+    record[TELEMETRY_STATUS_BLOB_SIZE + 1] = (uint8_t) (blob_size >> 8);
+    record[TELEMETRY_STATUS_BLOB_X] = blob_center_x;
+    record[TELEMETRY_STATUS_BLOB_Y] = blob_center_y;
+    record[TELEMETRY_STATUS_PWM_A] = (uint8_t) pwm_a;
+    record[TELEMETRY_STATUS_PWM_A + 1] = (uint8_t) (pwm_a >> 8);
+    record[TELEMETRY_STATUS_PWM_B] = (uint8_t) pwm_b;
+    record[TELEMETRY_STATUS_PWM_B + 1] = (uint8_t) (pwm_b >> 8);
+    record[TELEMETRY_STATUS_BATTERY] = (uint8_t) battery;
+    record[TELEMETRY_STATUS_BATTERY + 1] = (uint8_t) (battery >> 8);
+    record[TELEMETRY_STATUS_DROPPED] = telemetry_dropped();
+    record[TELEMETRY_STATUS_LINK_BYTES] = (uint8_t) camera_link_bytes;
+    record[TELEMETRY_STATUS_LINK_BYTES + 1] = (uint8_t) (camera_link_bytes >> 8);
+    record[TELEMETRY_STATUS_LINK_RATE] = camera_link_packets;
+    record[TELEMETRY_STATUS_RECOVER] = (uint8_t) camera_recover_ticks;
+    record[TELEMETRY_STATUS_RECOVER + 1] = (uint8_t) (camera_recover_ticks >> 8);
+    record[TELEMETRY_STATUS_FIRST_BLOB] = (uint8_t) camera_first_blob;
+    record[TELEMETRY_STATUS_FIRST_BLOB + 1] = (uint8_t) (camera_first_blob >> 8);
+    record[TELEMETRY_STATUS_RESYNCS] = camera_resyncs;
+    record[TELEMETRY_STATUS_CONFIDENCE] = blob_confidence;
+    record[TELEMETRY_STATUS_STACK] = (uint8_t) stack;
+    record[TELEMETRY_STATUS_STACK + 1] = (uint8_t) (stack >> 8);
+
+    // Queue the record.  It is dropped rather than waited on if the
+    // telemetry ring is full.
+    telemetry_send(record, TELEMETRY_STATUS_LENGTH);
+}
+
+
 int16_t camera_fsm()
 // Implements camera finite state machine.
 {
@@ -369,85 +1180,240 @@ int16_t camera_fsm()
 
         FSM_STATE_BEGIN(PING)
 
-            // Disable any tracking.
-            usart_xmit_buffer("DT\r", 3);
+            // Report the state.
+            camera_state_set(CAMERA_STATE_PING);
 
-            // Set the timer to wait 1 second.
-            timer_wait_set(1, 10);
+#ifdef CAMERA_BAUD_COMMAND
+            // Fall back to the boot rate once the camera stops replying.
+            if (camera_backoff == CAMERA_BACKOFF_MAX) camera_baud_reset();
+#endif
+
+            // Discard anything left over from a previous attempt.
+            usart_recv_flush();
+            camera_frame_reset();
+            camera_replies = 0;
+
+            // Disable any tracking and ping the camera in one go.  Both
+            // commands are acknowledged in order.
+            usart_xmit_buffer("DT\rPG\r", 6);
+
+            // Time the replies, backing off further should this attempt fail.
+            camera_wait_set();
+
+            // Wait for the replies.
+            fsm_change_state(1, PING_ACK);
+
+        FSM_STATE_END
+
+        FSM_STATE_BEGIN(PING_ACK)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_PING_ACK);
+
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
+
+            // Read the next reply.
+            camera_reply = camera_reply_read();
+
+            // Count the replies.
+            if (camera_reply != CAMERA_REPLY_NONE) ++camera_replies;
+
+#ifdef CAMERA_BAUD_COMMAND
+            // Negotiate the baud rate if the ping was acknowledged.
+            fsm_change_state((camera_replies >= 2) && (camera_reply == CAMERA_REPLY_ACK), BAUD);
+#endif
+
+#ifdef CAMERA_FILTER_COMMAND
+            // Restrict the stream to the blob color if the ping was acknowledged.
+            fsm_change_state((camera_replies >= 2) && (camera_reply == CAMERA_REPLY_ACK), FILTER);
+#endif
+
+            // Start tracking if the ping was acknowledged.
+            fsm_change_state((camera_replies >= 2) && (camera_reply == CAMERA_REPLY_ACK), ENABLE_TRACKING);
 
-            // Pause until the timer is finished.
-            fsm_wait_until(timer_wait_done(1));
+            // Restart if the ping was not acknowledged.
+            fsm_change_state(camera_replies >= 2, PING);
 
-            // Transmit the ping.
+            // Restart if the wait is over.
+            fsm_change_state(timer_ticks_passed(camera_deadline), PING);
+
+        FSM_STATE_END
+
+#ifdef CAMERA_BAUD_COMMAND
+        FSM_STATE_BEGIN(BAUD)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_BAUD);
+
+#ifdef CAMERA_FILTER_COMMAND
+            // Carry on once running at the target rate.
+            fsm_change_state(camera_baud == camera_baud_target, FILTER);
+#else
+            // Carry on once running at the target rate.
+            fsm_change_state(camera_baud == camera_baud_target, ENABLE_TRACKING);
+#endif
+
+            // Ask the camera for the target rate at the current rate.
+            usart_xmit_buffer(camera_baud_command[camera_baud_target], strlen(camera_baud_command[camera_baud_target]));
+
+            // Time the reply, backing off further should this attempt fail.
+            camera_wait_set();
+
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
+
+            // Read the next reply.
+            camera_reply = camera_reply_read();
+
+            // Verify the new rate if the camera agrees.
+            fsm_change_state(camera_reply == CAMERA_REPLY_ACK, BAUD_VERIFY);
+
+            // Try the next slower rate if the camera refuses.
+            fsm_change_state((camera_reply == CAMERA_REPLY_NCK) && camera_baud_slower(), BAUD);
+
+            // Restart if refused or the wait is over.
+            fsm_change_state(camera_reply == CAMERA_REPLY_NCK, PING);
+            fsm_change_state(timer_ticks_passed(camera_deadline), PING);
+
+        FSM_STATE_END
+
+        FSM_STATE_BEGIN(BAUD_VERIFY)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_BAUD_VERIFY);
+
+            // Let the command finish and the camera switch rates.
+            camera_deadline = timer_get_ticks() + 2;
+            fsm_wait_until(usart_xmit_buffer_ready() && timer_ticks_passed(camera_deadline));
+
+            // Switch to the new rate.
+            usart_set_baud(camera_baud_ubrr[camera_baud_target]);
+            usart_recv_flush();
+
+            // Ping the camera at the new rate.
             usart_xmit_buffer("PG\r", 3);
 
-            // Set the timer to wait 1 second.
-            timer_wait_set(1, 10);
+            // Set the time to wait for the reply.
+            camera_deadline = timer_get_ticks() + CAMERA_BACKOFF_MIN;
 
-            fsm_checkpoint();
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
 
-            // Check for ACK.
-            fsm_change_state(usart_recv_buffer_has_eol('\r'), PING_ACK);
+            // Read the next reply.
+            camera_reply = camera_reply_read();
 
-            // Restart if timer is done.
-            fsm_change_state(timer_wait_done(1), PING);
+            // Keep the new rate if the ping was acknowledged.
+            if (camera_reply == CAMERA_REPLY_ACK)
+            {
+                camera_baud = camera_baud_target;
+                recorder_event(RECORDER_BAUD, camera_baud, 1);
+            }
+
+            // Carry on at the new rate.
+            fsm_change_state(camera_reply == CAMERA_REPLY_ACK, BAUD);
+
+            // Otherwise go back to the old rate, which the camera also
+            // returns to, and target the next slower rate.
+            if ((camera_reply == CAMERA_REPLY_NCK) || timer_ticks_passed(camera_deadline))
+            {
+                usart_set_baud(camera_baud_ubrr[camera_baud]);
+                recorder_event(RECORDER_BAUD, camera_baud_target, 0);
+                camera_baud_slower();
+                fsm_change_state(1, PING);
+            }
 
         FSM_STATE_END
+#endif
 
-        FSM_STATE_BEGIN(PING_ACK)
+#ifdef CAMERA_FILTER_COMMAND
+        FSM_STATE_BEGIN(FILTER)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_FILTER);
 
-            // Read the buffer of data.
-            usart_recv_buffer(camera_ack, 8, '\r');
+            // Transmit the color filter.
+            usart_xmit_buffer(CAMERA_FILTER_COMMAND, sizeof(CAMERA_FILTER_COMMAND) - 1);
+
+            // Time the reply, backing off further should this attempt fail.
+            camera_wait_set();
+
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
+
+            // Read the next reply.
+            camera_reply = camera_reply_read();
 
             // Start tracking if we got the ack.
-            fsm_change_state (!strncmp(camera_ack, "ACK\r", 4), ENABLE_TRACKING);
+            fsm_change_state(camera_reply == CAMERA_REPLY_ACK, ENABLE_TRACKING);
 
             // Restart if not ack.
-            fsm_change_state(1, PING);
+            fsm_change_state(camera_reply == CAMERA_REPLY_NCK, PING);
+
+            // Restart if the wait is over.
+            fsm_change_state(timer_ticks_passed(camera_deadline), PING);
 
         FSM_STATE_END
+#endif
 
         FSM_STATE_BEGIN(ENABLE_TRACKING)
 
-            // Transmit the enable tracking.
-            usart_xmit_buffer("ET\r", 3);
+            // Report the state.
+            camera_state_set(CAMERA_STATE_ENABLE_TRACKING);
 
-            // Set the timer to wait 1 second.
-            timer_wait_set(1, 10);
+            // The camera is responding so start over with short waits.
+            camera_backoff = CAMERA_BACKOFF_MIN;
 
-            fsm_checkpoint();
+            // Transmit the enable tracking.
+            usart_xmit_buffer("ET\r", 3);
 
-            // Check for ACK.
-            fsm_change_state(usart_recv_buffer_has_eol('\r'), ENABLE_TRACKING_ACK);
+            // Time the reply, backing off further should this attempt fail.
+            camera_wait_set();
 
-            // Restart if timer is done.
-            fsm_change_state(timer_wait_done(1), PING);
+            // Wait for the reply.
+            fsm_change_state(1, ENABLE_TRACKING_ACK);
 
         FSM_STATE_END
 
-
         FSM_STATE_BEGIN(ENABLE_TRACKING_ACK)
 
-            // Read the buffer of data.
-            usart_recv_buffer(camera_ack, 8, '\r');
+            // Report the state.
+            camera_state_set(CAMERA_STATE_ENABLE_TRACKING_ACK);
+
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
+
+            // Read the next reply.
+            camera_reply = camera_reply_read();
 
             // Start tracking if we got the ack.
-            fsm_change_state (!strncmp(camera_ack, "ACK\r", 4), TRACKING);
+            fsm_change_state(camera_reply == CAMERA_REPLY_ACK, TRACKING);
 
             // Restart if not ack.
-            fsm_change_state(1, PING);
+            fsm_change_state(camera_reply == CAMERA_REPLY_NCK, PING);
+
+            // Restart if the wait is over.
+            fsm_change_state(timer_ticks_passed(camera_deadline), PING);
 
         FSM_STATE_END
 
         FSM_STATE_BEGIN(TRACKING)
 
+            // Report the state.
+            camera_state_set(CAMERA_STATE_TRACKING);
+
             // Set the timer to wait .2 second.
             timer_wait_set(1, 2);
 
-            fsm_checkpoint();
+            // Wait for bytes to frame or the timer.
+#ifdef CAMERA_BAUD_COMMAND
+            fsm_wait_until(usart_recv_buffer_ready() || timer_wait_done(1) || camera_link_noisy);
+#else
+            fsm_wait_until(usart_recv_buffer_ready() || timer_wait_done(1));
+#endif
 
             // Check for a response packet from the camera.
-            fsm_change_state(usart_recv_buffer_has_eol(0xFF), TRACKING_PACKET);
+            fsm_change_state(camera_packet_read(), TRACKING_PACKET);
 
             // Has the timer expired?
             if (timer_wait_done(1))
@@ -455,34 +1421,181 @@ int16_t camera_fsm()
                 // Turn of the tracking LED.
                 leds_yellow_off();
 
-                // Reset the blob information.
-                blob_size = 0;
-                blob_center_x = 88;
-                blob_center_y = 72;
+                // Lower the confidence in the blob.
+                blob_timeout();
+
+                // Record the timeout.
+                recorder_event(RECORDER_TIMEOUT, 0, 0);
+
+                // Count the consecutive timeouts.
+                ++camera_timeouts;
+
+                // Wait another .2 second before timing out again.
+                timer_wait_set(1, 2);
             }
 
+            // Try to resynchronize a stalled link.
+            fsm_change_state(camera_timeouts >= CAMERA_STALL_TIMEOUTS, RESYNC);
+
+#ifdef CAMERA_BAUD_COMMAND
+            // Negotiate a slower rate if the link is noisy.
+            fsm_change_state(camera_baud_noisy(), PING);
+#endif
+
         FSM_STATE_END
 
         FSM_STATE_BEGIN(TRACKING_PACKET)
 
-            // Read the packet of data.
-            camera_packet_len = usart_recv_buffer(camera_packet, 64, 0xFF);
+            // Report the state.
+            camera_state_set(CAMERA_STATE_TRACKING_PACKET);
 
             // Process the packet.
             camera_packet_process();
 
+            // Update the link watchdog.
+            camera_link_packet();
+
+#ifdef CAMERA_ROI_COMMAND
+            // Follow the blob with the region of interest.
+            camera_roi_update();
+#endif
+
+            // Record how long it took from boot to see the first blob.
+            if (blob_size && !camera_first_blob)
+            {
+                camera_first_blob = timer_get_ticks();
+                recorder_event(RECORDER_FIRST_BLOB, (uint8_t) camera_first_blob, (uint8_t) (camera_first_blob >> 8));
+            }
+
+            // Record the packet arrival.
+            recorder_event(RECORDER_PACKET, blob_center_x, (blob_size > 255) ? 255 : (uint8_t) blob_size);
+
             // Go back to tracking.
             fsm_change_state(1, TRACKING);
 
         FSM_STATE_END
 
+        FSM_STATE_BEGIN(RESYNC)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_RESYNC);
+
+            // Note the stall.
+            camera_link_stall();
+            camera_timeouts = 0;
+
+            // Discard any partial packet left in the buffer.
+            usart_recv_flush();
+            camera_frame_reset();
+
+            // Immediately re-enable tracking rather than going through
+            // the full handshake.
+            usart_xmit_buffer("ET\r", 3);
+
+            // Wait for the reply.
+            camera_deadline = timer_get_ticks() + CAMERA_BACKOFF_MIN;
+            fsm_change_state(1, RESYNC_ACK);
+
+        FSM_STATE_END
+
+        FSM_STATE_BEGIN(RESYNC_ACK)
+
+            // Report the state.
+            camera_state_set(CAMERA_STATE_RESYNC_ACK);
+
+            // Wait for a reply or the end of the wait.
+            fsm_wait_until(camera_reply_ready());
+
+            // Read the next reply.
+            camera_reply = camera_reply_read();
+
+            // Resume tracking if we got the ack.
+            fsm_change_state(camera_reply == CAMERA_REPLY_ACK, TRACKING);
+
+            // Fall back to the full handshake if not ack.
+            fsm_change_state(camera_reply == CAMERA_REPLY_NCK, PING);
+
+            // Fall back to the full handshake if the wait is over.
+            fsm_change_state(timer_ticks_passed(camera_deadline), PING);
+
+        FSM_STATE_END
+
     FSM_END
 }
 
 
-int main (void)
+void tablebot_tick(void)
+// Run the TableBot state machine on the control tick.
+{
+    // Update the battery voltage and motor compensation.
+    battery_update();
+
+    // Run the finite state machine.
+    tablebot_fsm();
+
+    // The state machine is still running.
+    watchdog_checkin(WATCHDOG_TABLEBOT);
+}
+
+
+void tablebot_status(void)
+// Blink the green LED once a second and sample the camera link throughput
+// as it comes on.
+{
+    static uint8_t status_half = 0;
+
+    // Turn the LED off for the first half of the second.
+    status_half ^= 1;
+    if (status_half)
+    {
+        leds_green_off();
+        return;
+    }
+
+    // Sample the camera link throughput each second.
+    camera_link_update();
+
+    // Turn the LED on for the second half.
+    leds_green_on();
+}
+
+
+void camera_task(void)
+// Poll the camera.
 {
-    uint8_t    counter;
+    // Run the camera finite state machine.
+    camera_fsm();
+
+    // The camera is still being polled.
+    watchdog_checkin(WATCHDOG_CAMERA);
+}
+
+
+// Main loop tasks from the highest priority to the lowest with their
+// period, first release and deadline in 1/100th second ticks.  The state
+// machine reacting to the sensors comes first so nothing added later can
+// delay it by more than one pass.  The sensor reflexes themselves run in
+// the interrupts.  The camera is polled whenever nothing else is due.
+static const sched_task_t tablebot_tasks[] =
+{
+    { tablebot_tick, 10, 10, 2 },
+    { tablebot_status, 50, 50, 10 },
+    { tablebot_telemetry, TELEMETRY_PERIOD * 10, TELEMETRY_PERIOD * 10, 50 },
+    { camera_task, 0, 0, 0 },
+};
+
+void tablebot_init(void)
+// Initialize the robot.
+{
+    uint8_t    reset_flags;
+
+    // Get and clear the cause of the reset.
+    reset_flags = MCUSR;
+    MCUSR = 0;
+
+    // The watchdog stays enabled after a watchdog reset so turn it off
+    // until the robot is initialized.
+    wdt_disable();
 
     // Initialize the LEDs.
     leds_init();
@@ -490,14 +1603,34 @@ int main (void)
     // Initialize the timer.
     timer_init();
 
+    // Initialize the main loop profiler.
+    profile_init();
+
     // Initialize the motor.
     motors_init();
 
     // Initialize the sensors.
     sensors_init();
 
+    // Initialize the analog sensors.
+    adc_init();
+
+    // Initialize the battery monitor.
+    battery_init();
+
+    // Initialize the telemetry.
+    telemetry_init();
+
+    // Initialize the flight recorder.  This saves the events leading up to
+    // a watchdog or brown-out reset so it must run before interrupts are
+    // enabled.
+    recorder_init(reset_flags);
+
     // Initialize the USART.
-    usart_init(BAUD2UBRR_115200);
+    usart_init(USART_UBRR(USART_BAUD));
+
+    // Clear the interrupt latency histograms.
+    latency_init();
 
     // Enable interrupts.
     sei();
@@ -506,42 +1639,32 @@ int main (void)
     motors_a_pwm(0);
     motors_b_pwm(0);
 
-    // Reset the counter.
-    counter = 0;
+    // Start the main loop tasks.
+    sched_init(tablebot_tasks, sizeof(tablebot_tasks) / sizeof(tablebot_tasks[0]));
 
-    // Loop forever.
-    for (;;)
-    {
-        // Update the sensors.
-        sensors_update();
+    // Start supervising the main loop.
+    watchdog_init();
+}
 
-        // Is the timer ready flag set.
-        if (timer_is_ready())
-        {
-            // Increment the counter.
-            ++counter;
- 
-            // Reset the counter at the count of 1 second.
-            if (counter == 10) counter = 0;
 
-            // Toggle green LED as needed.
-            if (counter == 0) leds_green_on();
-            if (counter == 5) leds_green_off();
+void tablebot_loop(void)
+// Make one pass through the main loop.
+{
+    // Run the task due.
+    sched_dispatch();
 
-            // Update the yellow LED to reflect the sensor state.
-            // if (sensors_get()) leds_yellow_on(); else leds_yellow_off();
+    // Service the watchdog once every task has checked in.
+    watchdog_service();
+}
 
-            // Run the finite state machine.
-            tablebot_fsm();
 
-            // Clear the timer flag.
-            timer_clear_ready();
-        }
+int main (void)
+{
+    // Initialize the robot.
+    tablebot_init();
 
-        // Run the camera finite state machine.
-        camera_fsm();
-    }
+    // Loop forever.
+    for (;;) tablebot_loop();
 
     return 0;
 }
-
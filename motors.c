@@ -25,10 +25,38 @@
 */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include "latency.h"
 #include "motors.h"
+#include "recorder.h"
+
+// Waveform generation mode bits.  The 8, 9 and 10-bit modes differ only
+// in WGM11:WGM10 while WGM12 selects fast PWM over phase correct PWM.
+#define MOTORS_WGM_BITS     (MOTORS_PWM_BITS - 7)
+#define MOTORS_WGM_FAST     ((MOTORS_PWM_MODE == MOTORS_PWM_FAST) ? 1 : 0)
+
+// Clock select bits for the PWM prescale.
+#if MOTORS_PWM_PRESCALE == 1
+#define MOTORS_CS_BITS      ((0<<CS12) | (0<<CS11) | (1<<CS10))
+#elif MOTORS_PWM_PRESCALE == 8
+#define MOTORS_CS_BITS      ((0<<CS12) | (1<<CS11) | (0<<CS10))
+#else
+#define MOTORS_CS_BITS      ((0<<CS12) | (1<<CS11) | (1<<CS10))
+#endif
+
+volatile uint8_t motors_reflex_active;
+
+// PWM compensation scale in 8.8 fixed point.
+static uint16_t motors_scale;
 
 void motors_init(void)
 {
+    // Clear the reflex override.
+    motors_reflex_active = 0;
+
+    // No PWM compensation until the battery voltage is known.
+    motors_scale = MOTORS_SCALE_UNITY;
+
     // Make sure the motor A and motor B are disabled.
     PORTB |= (PB0 | PB5);
 
@@ -49,12 +77,13 @@ void motors_init(void)
     // Enable timer 1A and timer 1B.
     TCCR1A = (1<<COM1A1) | (0<<COM1A0) |                    // Clear OC1A on compare match on up-count, set at top.
              (1<<COM1B1) | (1<<COM1B0) |                    // Set OC1B on compare match on up-count, clear at top.
-             (0<<WGM11) | (1<<WGM10);                       // Fast PWM, 8-bit.
+             (((MOTORS_WGM_BITS >> 1) & 1)<<WGM11) |        // 8, 9 or 10-bit PWM.
+             ((MOTORS_WGM_BITS & 1)<<WGM10);
 
     // Set clock select bits to start timer.
     TCCR1B = (0<<ICNC1) | (0<<ICES1) |                      // Input on ICP1 disabled.
-             (0<<WGM13) | (1<<WGM12) |                      // Fast PWM, 8-bit.
-             (0<<CS12) | (0<<CS11) | (1<<CS10);             // Clk/1 - no prescaling.
+             (0<<WGM13) | (MOTORS_WGM_FAST<<WGM12) |        // Fast or phase correct PWM.
+             MOTORS_CS_BITS;                                // Clk/1, clk/8 or clk/64 prescaling.
 
     // Clear TCCR1C when operating in a PWM mode.
     TCCR1C &= ~(FOC1A | FOC1B);
@@ -66,7 +95,12 @@ void motors_init(void)
 
 void motors_a_pwm(int16_t pwm)
 {
+    uint8_t sreg;
     int16_t pwm_output;
+    uint8_t stamp;
+
+    // Compensate for the battery voltage.
+    pwm = (int16_t) (((int32_t) pwm * motors_scale) >> 8);
 
     // Sanity check for maximum and minimum values.
     if (pwm > MOTORS_MAX_PWM) pwm = MOTORS_MAX_PWM;
@@ -75,14 +109,33 @@ void motors_a_pwm(int16_t pwm)
     // Determine the PWM output.
     pwm_output = MOTORS_IDLE_PWM + pwm;
 
-    // Update the PWM value.
-    OCR1A = (uint16_t) pwm_output;
+    // Save the interrupt state and disable interrupts so the 16-bit
+    // register write can't be interleaved with the sensor reflex.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    // Update the PWM value unless the sensor reflex has taken over.
+    if (!motors_reflex_active && (OCR1A != (uint16_t) pwm_output))
+    {
+        OCR1A = (uint16_t) pwm_output;
+
+        // Record the change.
+        recorder_event(RECORDER_PWM_A, (uint8_t) pwm_output, (uint8_t) (pwm_output >> 8));
+    }
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
 }
 
 
 void motors_b_pwm(int16_t pwm)
 {
+    uint8_t sreg;
     int16_t pwm_output;
+    uint8_t stamp;
+
+    // Compensate for the battery voltage.
+    pwm = (int16_t) (((int32_t) pwm * motors_scale) >> 8);
 
     // Sanity check for maximum and minimum values.
     if (pwm > MOTORS_MAX_PWM) pwm = MOTORS_MAX_PWM;
@@ -91,7 +144,76 @@ void motors_b_pwm(int16_t pwm)
     // Determine the PWM output.
     pwm_output = MOTORS_IDLE_PWM + pwm;
 
-    // Update the PWM value.
-    OCR1B = (uint16_t) pwm_output;
+    // Save the interrupt state and disable interrupts so the 16-bit
+    // register write can't be interleaved with the sensor reflex.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    // Update the PWM value unless the sensor reflex has taken over.
+    if (!motors_reflex_active && (OCR1B != (uint16_t) pwm_output))
+    {
+        OCR1B = (uint16_t) pwm_output;
+
+        // Record the change.
+        recorder_event(RECORDER_PWM_B, (uint8_t) pwm_output, (uint8_t) (pwm_output >> 8));
+    }
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
 }
 
+
+int16_t motors_a_output(void)
+// Return the PWM currently output to motor A relative to idle.
+{
+    uint8_t sreg;
+    uint16_t pwm_output;
+    uint8_t stamp;
+
+    // Disable interrupts while the 16-bit register is read.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    pwm_output = OCR1A;
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
+
+    return (int16_t) pwm_output - MOTORS_IDLE_PWM;
+}
+
+
+int16_t motors_b_output(void)
+// Return the PWM currently output to motor B relative to idle.
+{
+    uint8_t sreg;
+    uint16_t pwm_output;
+    uint8_t stamp;
+
+    // Disable interrupts while the 16-bit register is read.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    pwm_output = OCR1B;
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
+
+    return (int16_t) pwm_output - MOTORS_IDLE_PWM;
+}
+
+
+void motors_compensate(uint16_t scale)
+// Set the 8.8 fixed point scale applied to the PWM passed to motors_a_pwm()
+// and motors_b_pwm().  The new scale applies from the next PWM update.
+{
+    motors_scale = scale;
+}
+
+
+void motors_reflex_release(void)
+// Return control of the motors from the sensor reflex.  The motors keep
+// running at the reflex PWM until the next motors_a_pwm() or motors_b_pwm().
+{
+    motors_reflex_active = 0;
+}
@@ -27,12 +27,79 @@
 #ifndef _TB_MOTORS_H_
 #define _TB_MOTORS_H_ 1
 
-#define MOTORS_IDLE_PWM      127
-#define MOTORS_MAX_PWM       64
+// Timer1 PWM waveform modes.
+#define MOTORS_PWM_FAST             0
+#define MOTORS_PWM_PHASE_CORRECT    1
+
+// PWM waveform mode.  Fast PWM runs at twice the carrier frequency of
+// phase correct PWM for the same resolution, while phase correct PWM
+// keeps the pulses centered which is a little kinder to the H-bridge.
+#ifndef MOTORS_PWM_MODE
+#define MOTORS_PWM_MODE             MOTORS_PWM_FAST
+#endif
+
+// PWM resolution in bits.  Must be 8, 9 or 10.  The default 8 bits keeps
+// the 62.5 kHz carrier above hearing.  Finer steps are opt-in with
+// -DMOTORS_PWM_BITS=9 or 10, trading the carrier down into the audible
+// range where the motors whine.
+#ifndef MOTORS_PWM_BITS
+#define MOTORS_PWM_BITS             8
+#endif
+
+// PWM clock prescale.  Must be 1, 8 or 64.  The carrier frequency is
+// FOSC / (prescale * 2^bits) for fast PWM and half that for phase
+// correct PWM.  At 16 MHz with no prescaling this gives:
+//
+//      bits    fast        phase correct
+//       8      62.5 kHz    31.4 kHz        default, inaudible
+//       9      31.3 kHz    15.7 kHz
+//      10      15.6 kHz     7.8 kHz        audible whine
+//
+#ifndef MOTORS_PWM_PRESCALE
+#define MOTORS_PWM_PRESCALE         1
+#endif
+
+#if (MOTORS_PWM_BITS < 8) || (MOTORS_PWM_BITS > 10)
+#error "MOTORS_PWM_BITS must be 8, 9 or 10"
+#endif
+
+#if (MOTORS_PWM_PRESCALE != 1) && (MOTORS_PWM_PRESCALE != 8) && (MOTORS_PWM_PRESCALE != 64)
+#error "MOTORS_PWM_PRESCALE must be 1, 8 or 64"
+#endif
+
+// Speeds are expressed in steps of the selected PWM resolution.  The
+// MOTORS_SPEED() macro converts a speed given in the original 8-bit
+// steps (+/-64) to the selected resolution.
+#define MOTORS_PWM_TOP       ((1 << MOTORS_PWM_BITS) - 1)
+#define MOTORS_PWM_SCALE     (1 << (MOTORS_PWM_BITS - 8))
+#define MOTORS_SPEED(speed)  ((int16_t) (speed) * MOTORS_PWM_SCALE)
+
+#define MOTORS_IDLE_PWM      (MOTORS_PWM_TOP >> 1)
+#define MOTORS_MAX_PWM       MOTORS_SPEED(64)
 #define MOTORS_MIN_PWM       (-MOTORS_MAX_PWM)
 
+// Unity PWM compensation scale in 8.8 fixed point.
+#define MOTORS_SCALE_UNITY   256
+
+// Declare externally so in-lines work.
+extern volatile uint8_t motors_reflex_active;
+
 void motors_init(void);
 void motors_a_pwm(int16_t pwm);
 void motors_b_pwm(int16_t pwm);
+void motors_reflex_release(void);
+void motors_compensate(uint16_t scale);
+int16_t motors_a_output(void);
+int16_t motors_b_output(void);
+
+inline static void motors_reflex(int16_t pwm)
+// Drive both motors at the reflex PWM and ignore motors_a_pwm() and
+// motors_b_pwm() until motors_reflex_release() is called.  Must only be
+// called with interrupts disabled.
+{
+    OCR1A = (uint16_t) (MOTORS_IDLE_PWM + pwm);
+    OCR1B = (uint16_t) (MOTORS_IDLE_PWM + pwm);
+    motors_reflex_active = 1;
+}
 
 #endif // _TB_MOTORS_H_
@@ -0,0 +1,221 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "latency.h"
+#include "timer.h"
+#include "profile.h"
+
+#if PROFILE_ENABLE
+
+#if PROFILE_TASKS > 8
+#error "profile_background() keeps the background tasks in an 8 bit mask"
+#endif
+
+// Timer0 counts in the load window.
+#define PROFILE_WINDOW_COUNTS   ((uint32_t) PROFILE_WINDOW_TICKS * TIMER_TICK_COUNTS)
+
+// A time as the free running tick count and the Timer0 count within it.
+typedef struct
+{
+    uint16_t ticks;
+    uint8_t count;
+} profile_stamp_t;
+
+// Start of each task.
+static profile_stamp_t profile_started[PROFILE_TASKS];
+
+// Busy time of each task in this window and its load in the last window.
+static volatile uint16_t profile_busy[PROFILE_TASKS];
+static uint16_t profile_loads[PROFILE_TASKS];
+
+// Worst run time of each task.
+static uint16_t profile_longest[PROFILE_TASKS];
+
+// Tick the window started.
+static uint16_t profile_window;
+
+// Background tasks, which only run when nothing else is released.
+static uint8_t profile_background_tasks;
+
+static void profile_stamp(profile_stamp_t* when)
+// Get the time.
+{
+    uint8_t sreg;
+    uint8_t stamp;
+
+    // Disable interrupts while the time is read.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    when->ticks = timer_ticks;
+    when->count = TCNT0;
+
+    // A compare match which is not handled yet has restarted the count
+    // without counting the tick.
+    if (TIFR0 & (1<<OCF0A))
+    {
+        ++when->ticks;
+        when->count = TCNT0;
+    }
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
+}
+
+
+static uint16_t profile_span(const profile_stamp_t* start)
+// Return the Timer0 counts since the start.
+{
+    profile_stamp_t now;
+    int32_t span;
+
+    profile_stamp(&now);
+
+    span = (int32_t) (uint16_t) (now.ticks - start->ticks) * TIMER_TICK_COUNTS;
+    span += (int16_t) now.count - (int16_t) start->count;
+
+    // Keep the span in range.
+    if (span < 0) return 0;
+    if (span > 0xFFFF) return 0xFFFF;
+
+    return (uint16_t) span;
+}
+
+
+void profile_init(void)
+{
+    uint8_t i;
+
+    // Clear the busy times, loads and worst run times.
+    for (i = 0; i < PROFILE_TASKS; ++i)
+    {
+        profile_busy[i] = 0;
+        profile_loads[i] = 0;
+        profile_longest[i] = 0;
+    }
+    profile_background_tasks = 0;
+
+    // Start the window.
+    profile_window = timer_get_ticks();
+}
+
+
+void profile_start(uint8_t task)
+// Note the start of a task.
+{
+    profile_stamp(&profile_started[task]);
+}
+
+
+void profile_end(uint8_t task)
+// Add the time since the start of a task to its busy time.
+{
+    uint16_t span;
+    uint16_t busy;
+
+    span = profile_span(&profile_started[task]);
+
+    // Note the worst run time.
+    if (span > profile_longest[task]) profile_longest[task] = span;
+
+    // Add without wrapping.
+    busy = profile_busy[task] + span;
+    profile_busy[task] = (busy < span) ? 0xFFFF : busy;
+}
+
+
+void profile_update(void)
+// Work out the loads at the end of each window.
+{
+    uint8_t i;
+    uint8_t sreg;
+    uint8_t stamp;
+    uint16_t busy;
+    uint32_t load;
+
+    // Wait for the end of the window.
+    if ((uint16_t) (timer_get_ticks() - profile_window) < PROFILE_WINDOW_TICKS) return;
+    profile_window += PROFILE_WINDOW_TICKS;
+
+    // Work out the load of each task in per mille of the window.
+    for (i = 0; i < PROFILE_TASKS; ++i)
+    {
+        // Disable interrupts while the busy time is read and cleared.
+        sreg = SREG;
+        LATENCY_CLI(stamp);
+
+        busy = profile_busy[i];
+        profile_busy[i] = 0;
+
+        // Restore the interrupt state.
+        LATENCY_RESTORE(sreg, stamp);
+
+        load = ((uint32_t) busy * 1000) / PROFILE_WINDOW_COUNTS;
+        profile_loads[i] = (load > 1000) ? 1000 : (uint16_t) load;
+    }
+}
+
+
+uint16_t profile_load(uint8_t task)
+// Return the load of a task over the last window in per mille.
+{
+    return profile_loads[task];
+}
+
+
+void profile_background(uint8_t task)
+// Note a background task.  A background task polls whenever nothing else
+// is released, mostly finding nothing to do, so its busy time is spare
+// time rather than load.
+{
+    profile_background_tasks |= (1<<task);
+}
+
+
+uint16_t profile_idle(void)
+// Return the time over the last window no task other than a background
+// one was busy in per mille.
+{
+    uint8_t i;
+    uint16_t busy = 0;
+
+    for (i = 0; i < PROFILE_TASKS; ++i)
+    {
+        if (!(profile_background_tasks & (1<<i))) busy += profile_loads[i];
+    }
+
+    return (busy > 1000) ? 0 : 1000 - busy;
+}
+
+
+uint16_t profile_worst(uint8_t task)
+// Return the worst run time of a task in Timer0 counts.
+{
+    return profile_longest[task];
+}
+
+#endif // PROFILE_ENABLE
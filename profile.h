@@ -0,0 +1,67 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#ifndef _TB_PROFILE_H_
+#define _TB_PROFILE_H_ 1
+
+// Main loop profiler.  Accounts the time each task is busy over a one
+// second window and the worst time each run takes.  Times are in Timer0
+// counts of 64 us.  A task shorter than a count is still accounted on
+// average as its start falls at random within a count.  The busy time of
+// a main loop task includes any interrupts taken while it ran.
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE          1
+#endif
+
+// Profiled tasks.  The scheduler profiles each task in its table.
+#define PROFILE_SENSORS         0               // sensors_update() in the timer interrupt.
+#define PROFILE_TASK(task)      ((task) + 1)    // Scheduled task.
+#define PROFILE_TASKS           7
+
+// 1/100th second ticks in the load window.
+#define PROFILE_WINDOW_TICKS    100
+
+#if PROFILE_ENABLE
+
+void profile_init(void);
+void profile_start(uint8_t task);
+void profile_end(uint8_t task);
+void profile_update(void);
+uint16_t profile_load(uint8_t task);
+void profile_background(uint8_t task);
+uint16_t profile_idle(void);
+uint16_t profile_worst(uint8_t task);
+
+#else
+
+#define profile_init()          ((void) 0)
+#define profile_start(task)     ((void) 0)
+#define profile_end(task)       ((void) 0)
+#define profile_update()        ((void) 0)
+#define profile_background(task) ((void) 0)
+
+#endif // PROFILE_ENABLE
+
+#endif // _TB_PROFILE_H_
@@ -0,0 +1,164 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include "latency.h"
+#include "timer.h"
+#include "recorder.h"
+
+// Magic value marking a valid ring in memory.
+#define RECORDER_RING_MAGIC         0x5242      // "RB"
+
+// The ring is kept out of the zeroed .bss section so the events leading
+// up to a watchdog or brown-out reset survive it to be snapshotted.
+static struct
+{
+    uint16_t magic;
+    uint8_t head;
+    uint8_t count;
+    uint8_t ticks_high;
+    uint8_t events[RECORDER_EVENTS][4];
+} recorder __attribute__ ((section (".noinit")));
+
+void recorder_init(uint8_t reset_flags)
+// Initialize the recorder.  If the reset was caused by the watchdog or a
+// brown-out the events from before the reset are saved to the EEPROM.
+{
+    // Save the events leading up to an abnormal reset.
+    if ((recorder.magic == RECORDER_RING_MAGIC) &&
+        (recorder.count <= RECORDER_EVENTS) &&
+        (reset_flags & ((1<<WDRF) | (1<<BORF))))
+    {
+        recorder_snapshot(reset_flags & ((1<<WDRF) | (1<<BORF)));
+    }
+
+    // Clear the ring.
+    recorder.head = 0;
+    recorder.count = 0;
+    recorder.ticks_high = 0;
+    recorder.magic = RECORDER_RING_MAGIC;
+
+    // Record the reset.
+    recorder_event(RECORDER_RESET, reset_flags, 0);
+}
+
+
+void recorder_event(uint8_t type, uint8_t a, uint8_t b)
+// Record an event.  Safe to call from interrupts.
+{
+    uint8_t sreg;
+    uint8_t head;
+    uint8_t ticks_low;
+    uint8_t ticks_high;
+    uint8_t stamp;
+
+    // Disable interrupts while the event is added.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+
+    // Get the timestamp.
+    ticks_low = (uint8_t) timer_ticks;
+    ticks_high = (uint8_t) (timer_ticks >> 8);
+    head = recorder.head;
+
+    // Only the low byte of the ticks is kept with each event so record
+    // the high byte each time it changes.
+    if (ticks_high != recorder.ticks_high)
+    {
+        recorder.events[head][0] = RECORDER_TIME;
+        recorder.events[head][1] = ticks_low;
+        recorder.events[head][2] = ticks_high;
+        recorder.events[head][3] = recorder.ticks_high;
+        head = (head + 1) & (RECORDER_EVENTS - 1);
+        if (recorder.count < RECORDER_EVENTS) ++recorder.count;
+        recorder.ticks_high = ticks_high;
+    }
+
+    // Add the event.
+    recorder.events[head][0] = type;
+    recorder.events[head][1] = ticks_low;
+    recorder.events[head][2] = a;
+    recorder.events[head][3] = b;
+    recorder.head = (head + 1) & (RECORDER_EVENTS - 1);
+    if (recorder.count < RECORDER_EVENTS) ++recorder.count;
+
+    // Restore the interrupt state.
+    LATENCY_RESTORE(sreg, stamp);
+}
+
+
+void recorder_snapshot(uint8_t cause)
+// Save the events in the ring to the EEPROM from the oldest to the newest.
+// This waits on each EEPROM write and takes about half a second so it
+// should only be triggered with the motors stopped.
+{
+    uint8_t header[RECORDER_HEADER_LENGTH];
+    uint8_t i;
+    uint8_t index;
+    uint8_t count;
+    uint16_t ticks;
+    uint8_t* address;
+    uint8_t sreg;
+    uint8_t stamp;
+
+    // Get the ring position.  Events recorded while the snapshot is being
+    // written may replace the oldest events before they are saved.  This
+    // runs from tablebot_init() too so the interrupt state is restored
+    // rather than interrupts enabled.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+    ticks = timer_ticks;
+    count = recorder.count;
+    index = (recorder.head - count) & (RECORDER_EVENTS - 1);
+    LATENCY_RESTORE(sreg, stamp);
+
+    // Fill in the header.
+    header[RECORDER_HEADER_MAGIC] = (uint8_t) RECORDER_EEPROM_MAGIC;
+    header[RECORDER_HEADER_MAGIC + 1] = (uint8_t) (RECORDER_EEPROM_MAGIC >> 8);
+    header[RECORDER_HEADER_CAUSE] = cause;
+    header[RECORDER_HEADER_COUNT] = count;
+    header[RECORDER_HEADER_TICKS] = (uint8_t) ticks;
+    header[RECORDER_HEADER_TICKS + 1] = (uint8_t) (ticks >> 8);
+
+    // Write the header.
+    address = (uint8_t*) RECORDER_EEPROM_ADDR;
+    eeprom_write_block(header, address, RECORDER_HEADER_LENGTH);
+    address += RECORDER_HEADER_LENGTH;
+
+    // Write the events from the oldest.
+    for (i = 0; i < count; ++i)
+    {
+        // Keep the watchdog from expiring during the slow writes.
+        wdt_reset();
+
+        eeprom_write_block(recorder.events[index], address, 4);
+        address += 4;
+        index = (index + 1) & (RECORDER_EVENTS - 1);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_RECORDER_H_
+#define _TB_RECORDER_H_ 1
+
+// Number of events kept in the ring.  Must be a power of two.
+#define RECORDER_EVENTS             32
+
+// Event types.  Each event is four bytes: the type, the low byte of the
+// 1/100th second timer ticks and two bytes of event data.
+#define RECORDER_TIME               0           // a = ticks high byte, b = previous high byte.
+#define RECORDER_RESET              1           // a = reset flags.
+#define RECORDER_TABLEBOT           2           // a = TableBot state.
+#define RECORDER_CAMERA             3           // a = camera state.
+#define RECORDER_SENSORS            4           // a = sensors state, b = sensors changed.
+#define RECORDER_REFLEX             5           // a = sensors triggering the reflex.
+#define RECORDER_PACKET             6           // a = blob center x, b = blob size up to 255.
+#define RECORDER_TIMEOUT            7           // Camera packet timeout.
+#define RECORDER_PWM_A              8           // a:b = motor A PWM register, little endian.
+#define RECORDER_PWM_B              9           // a:b = motor B PWM register, little endian.
+#define RECORDER_RESYNC             10          // Camera link stalled, resynchronizing.
+#define RECORDER_RECOVER            11          // a:b = ticks to recover the camera link.
+#define RECORDER_FIRST_BLOB         12          // a:b = ticks from boot to the first blob.
+#define RECORDER_BAUD               13          // a = camera baud rate index, b = 1 if in use, 0 if failed.
+
+// Snapshot causes other than the reset flags.
+#define RECORDER_CAUSE_EXPLICIT     0x80
+
+// EEPROM snapshot layout.  The header is followed by the events from the
+// oldest to the newest.
+#define RECORDER_EEPROM_ADDR        0
+#define RECORDER_EEPROM_MAGIC       0x5442      // "TB"
+#define RECORDER_HEADER_MAGIC       0           // 16-bit magic.
+#define RECORDER_HEADER_CAUSE       2           // Reset flags or explicit cause.
+#define RECORDER_HEADER_COUNT       3           // Number of events.
+#define RECORDER_HEADER_TICKS       4           // 16-bit ticks at the snapshot.
+#define RECORDER_HEADER_LENGTH      6
+
+void recorder_init(uint8_t reset_flags);
+void recorder_event(uint8_t type, uint8_t a, uint8_t b);
+void recorder_snapshot(uint8_t cause);
+
+#endif // _TB_RECORDER_H_
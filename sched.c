@@ -0,0 +1,163 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "timer.h"
+#include "profile.h"
+#include "sched.h"
+
+#if PROFILE_ENABLE && (PROFILE_TASKS < SCHED_MAX_TASKS + 1)
+#error "PROFILE_TASKS must cover the timer interrupt and every scheduled task"
+#endif
+
+// Task table.
+static const sched_task_t* sched_tasks;
+static uint8_t sched_count;
+
+// Next release tick of each periodic task.
+static uint16_t sched_release[SCHED_MAX_TASKS];
+
+// Releases started after their deadline and releases skipped entirely.
+static uint16_t sched_late_count[SCHED_MAX_TASKS];
+static uint16_t sched_missed_count[SCHED_MAX_TASKS];
+
+// Background task to try first next time.
+static uint8_t sched_background;
+
+void sched_init(const sched_task_t* tasks, uint8_t count)
+{
+    uint8_t i;
+    uint16_t now;
+
+    // Keep the table.
+    sched_tasks = tasks;
+    sched_count = (count > SCHED_MAX_TASKS) ? SCHED_MAX_TASKS : count;
+    sched_background = 0;
+
+    // Set the first releases from the current tick.
+    now = timer_get_ticks();
+    for (i = 0; i < sched_count; ++i)
+    {
+        sched_release[i] = now + sched_tasks[i].offset;
+        sched_late_count[i] = 0;
+        sched_missed_count[i] = 0;
+
+        // Background tasks don't count against the idle time.
+        if (!sched_tasks[i].period) profile_background(PROFILE_TASK(i));
+    }
+}
+
+
+static void sched_run(uint8_t task)
+// Run a task and account its run time.
+{
+    profile_start(PROFILE_TASK(task));
+    sched_tasks[task].run();
+    profile_end(PROFILE_TASK(task));
+}
+
+
+uint8_t sched_dispatch(void)
+// Run the highest priority released task, or the next background task if
+// none is released.  Returns the task run or SCHED_NONE.
+{
+    uint8_t i;
+    uint8_t task;
+    uint16_t now;
+    uint16_t age;
+    uint16_t missed;
+    uint32_t total;
+    uint8_t period;
+
+    // Close the profile window once it is over.
+    profile_update();
+
+    now = timer_get_ticks();
+
+    // Find the highest priority periodic task which is released.
+    for (i = 0; i < sched_count; ++i)
+    {
+        period = sched_tasks[i].period;
+        if (!period) continue;
+
+        // Is the task released?
+        age = now - sched_release[i];
+        if ((int16_t) age < 0) continue;
+
+        // Count a late start.
+        if ((age > sched_tasks[i].deadline) && (sched_late_count[i] != 0xFFFF)) ++sched_late_count[i];
+
+        // Count the releases which passed while this one waited and keep
+        // the releases in phase.
+        missed = age / period;
+        if (missed)
+        {
+            total = (uint32_t) sched_missed_count[i] + missed;
+            sched_missed_count[i] = (total > 0xFFFF) ? 0xFFFF : (uint16_t) total;
+        }
+        sched_release[i] += period * (missed + 1);
+
+#ifdef TIMER_VIRTUAL
+        // A released task is work even if its state machine is blocked, as
+        // another may be released at the same tick.
+        timer_work();
+#endif
+
+        sched_run(i);
+
+        return i;
+    }
+
+    // Let the background tasks take turns.
+    for (i = 0; i < sched_count; ++i)
+    {
+        task = sched_background;
+        if (++sched_background >= sched_count) sched_background = 0;
+
+        if (sched_tasks[task].period) continue;
+
+        sched_run(task);
+
+        return task;
+    }
+
+    return SCHED_NONE;
+}
+
+
+uint16_t sched_late(uint8_t task)
+// Return the count of releases of a task which started after the deadline.
+{
+    return sched_late_count[task];
+}
+
+
+uint16_t sched_missed(uint8_t task)
+// Return the count of releases of a task which were skipped because an
+// earlier release had not run by then.
+{
+    return sched_missed_count[task];
+}
@@ -0,0 +1,54 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#ifndef _TB_SCHED_H_
+#define _TB_SCHED_H_ 1
+
+// Cooperative task scheduler.  Tasks are listed in a static table from
+// the highest priority to the lowest.  Each pass of the main loop runs the
+// highest priority periodic task which has been released.  Background
+// tasks, with a period of zero, take turns only when no periodic task is
+// released, so a background task can never hold off a periodic one and a
+// lower priority periodic task can only delay a higher priority one by
+// its own run time.
+#define SCHED_MAX_TASKS         6
+
+// No task was run.
+#define SCHED_NONE              0xFF
+
+typedef struct
+{
+    void (*run)(void);          // Runs the task once.
+    uint8_t period;             // 1/100th second ticks between releases or 0 for background.
+    uint8_t offset;             // Tick of the first release.
+    uint8_t deadline;           // Ticks after the release the task must start by.
+} sched_task_t;
+
+void sched_init(const sched_task_t* tasks, uint8_t count);
+uint8_t sched_dispatch(void);
+uint16_t sched_late(uint8_t task);
+uint16_t sched_missed(uint8_t task);
+
+#endif // _TB_SCHED_H_
@@ -25,7 +25,7 @@
 */
 
 #ifndef _TB_SENSORS_H_
-#define _TB_SENSORS_ 1
+#define _TB_SENSORS_H_ 1
 
 #define SENSOR_LEFT_FRONT           0
 #define SENSOR_RIGHT_FRONT          1
@@ -35,6 +35,53 @@
 #define SENSOR_GROUND_LEFT_REAR     5
 #define SENSOR_GROUND_RIGHT_REAR    6
 
+#define SENSOR_COUNT                7
+
+// Sensor input ports.
+#define SENSOR_PORT_NONE            0
+#define SENSOR_PORT_B               1
+#define SENSOR_PORT_C               2
+#define SENSOR_PORT_D               3
+
+// Sensor input polarity.
+#define SENSOR_ACTIVE_LOW           0
+#define SENSOR_ACTIVE_HIGH          1
+
+// Sensor pin map.  Each logical sensor is wired to an input given as
+// (port, bit, polarity) where polarity is the input level when an
+// obstruction or edge is detected.  Sensors which are not wired to a
+// digital input use SENSOR_PORT_NONE and never trigger.  The front
+// proximity sensors are analog inputs sampled by the converter in adc.c.
+//
+//                                          port                bit     polarity
+#define SENSOR_MAP_LEFT_FRONT               (SENSOR_PORT_NONE,  0,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_RIGHT_FRONT              (SENSOR_PORT_NONE,  0,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_GROUND_FRONT             (SENSOR_PORT_D,     2,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_GROUND_LEFT_FRONT        (SENSOR_PORT_D,     3,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_GROUND_RIGHT_FRONT       (SENSOR_PORT_D,     4,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_GROUND_LEFT_REAR         (SENSOR_PORT_D,     5,      SENSOR_ACTIVE_HIGH)
+#define SENSOR_MAP_GROUND_RIGHT_REAR        (SENSOR_PORT_D,     6,      SENSOR_ACTIVE_HIGH)
+
+// Pin map field accessors.
+#define SENSOR_MAP_PORT_(port, bit, polarity)       (port)
+#define SENSOR_MAP_BIT_(port, bit, polarity)        (bit)
+#define SENSOR_MAP_POLARITY_(port, bit, polarity)   (polarity)
+#define SENSOR_MAP_PORT(map)                        SENSOR_MAP_PORT_ map
+#define SENSOR_MAP_BIT(map)                         SENSOR_MAP_BIT_ map
+#define SENSOR_MAP_POLARITY(map)                    SENSOR_MAP_POLARITY_ map
+
+// Pin mask of a sensor if it is wired to the port.
+#define SENSOR_PORT_MASK(map, port)  ((SENSOR_MAP_PORT(map) == (port)) ? (1 << SENSOR_MAP_BIT(map)) : 0)
+
+// Pin mask of all sensors wired to the port.
+#define SENSORS_PORT_MASK(port)     (SENSOR_PORT_MASK(SENSOR_MAP_LEFT_FRONT, port) |          \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_RIGHT_FRONT, port) |         \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_GROUND_FRONT, port) |        \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_GROUND_LEFT_FRONT, port) |   \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_GROUND_RIGHT_FRONT, port) |  \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_GROUND_LEFT_REAR, port) |    \
+                                     SENSOR_PORT_MASK(SENSOR_MAP_GROUND_RIGHT_REAR, port))
+
 #define SENSORS_FORWARD ((1<<SENSOR_LEFT_FRONT) | (1<<SENSOR_RIGHT_FRONT) | (1<<SENSOR_GROUND_FRONT) | (1<<SENSOR_GROUND_LEFT_FRONT) | (1<<SENSOR_GROUND_RIGHT_FRONT))
 #define SENSORS_REARWARD ((1<<SENSOR_GROUND_LEFT_REAR) | (1<<SENSOR_GROUND_RIGHT_REAR))
 
@@ -43,9 +90,39 @@
 #define SENSORS_LEFTWARD_GROUND(sensors) ((sensors & ((1<<SENSOR_GROUND_LEFT_FRONT) | (1<<SENSOR_GROUND_RIGHT_REAR))) == 0)
 #define SENSORS_RIGHTWARD_GROUND(sensors) ((sensors & ((1<<SENSOR_GROUND_RIGHT_FRONT) | (1<<SENSOR_GROUND_LEFT_REAR))) == 0)
 
+// Time an input must be continuously active before the sensor is
+// triggered and continuously inactive before it is released.  The
+// inputs are sampled every 10 ms and each time is limited to 150 ms.
+#ifndef SENSORS_PRESS_MS
+#define SENSORS_PRESS_MS            10
+#endif
+#ifndef SENSORS_RELEASE_MS
+#define SENSORS_RELEASE_MS          100
+#endif
+
+// Ground sensors watched by the pin change reflex.
+#define SENSORS_GROUND ((1<<SENSOR_GROUND_FRONT) | (1<<SENSOR_GROUND_LEFT_FRONT) | (1<<SENSOR_GROUND_RIGHT_FRONT) | (1<<SENSOR_GROUND_LEFT_REAR) | (1<<SENSOR_GROUND_RIGHT_REAR))
+
+// Default reflex actions taken from the pin change interrupt as soon as a
+// ground sensor input becomes active.  Sensors in the stop mask stop the
+// motors.  Sensors in the reverse mask drive away from the edge instead,
+// backward for forward sensors and forward for rearward sensors, or stop
+// if sensors on both ends are active.
+#ifndef SENSORS_REFLEX_STOP
+#define SENSORS_REFLEX_STOP         SENSORS_GROUND
+#endif
+#ifndef SENSORS_REFLEX_REVERSE
+#define SENSORS_REFLEX_REVERSE      SENSORS_GROUND
+#endif
+
+// Speed to drive away from the edge.
+#define SENSORS_REFLEX_PWM          MOTORS_SPEED(32)
+
 void sensors_init(void);
 void sensors_update(void);
 uint8_t sensors_get(void);
 uint8_t sensors_triggered(uint8_t sensors_mask);
+void sensors_reflex_set(uint8_t stop_mask, uint8_t reverse_mask);
+uint8_t sensors_reflex_clear(void);
 
 #endif // _TB_SENSORS_H_
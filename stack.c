@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+#include <avr/io.h>
+#include "stack.h"
+
+// End of the static data and the top of RAM from the linker.
+extern uint8_t _end;
+extern uint8_t __stack;
+
+void stack_paint(void) __attribute__ ((naked, used, section(".init1")));
+
+void stack_paint(void)
+// Paint the RAM from the end of the static data to the top of RAM.  This
+// runs from .init1 before the stack pointer and the zero register are set
+// up or the static data is initialized, so it is written in assembly to
+// use no stack whatever the optimization.
+{
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(_end)         \n"
+        "    ldi r31, hi8(_end)         \n"
+        "    ldi r24, %0                \n"
+        "    ldi r25, hi8(__stack)      \n"
+        "    rjmp 2f                    \n"
+        "1:  st Z+, r24                 \n"
+        "2:  cpi r30, lo8(__stack)      \n"
+        "    cpc r31, r25               \n"
+        "    brlo 1b                    \n"
+        "    breq 1b                    \n"
+        :
+        : "M" (STACK_PAINT));
+}
+
+
+uint16_t stack_unused(void)
+// Return the bytes above the static data the stack has never reached.
+{
+    const uint8_t* p = &_end;
+    uint16_t count = 0;
+
+    // Count the painted bytes up from the end of the static data.
+    while ((p <= &__stack) && (*p == STACK_PAINT))
+    {
+        ++p;
+        ++count;
+    }
+
+    return count;
+}
@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_STATES_H_
+#define _TB_STATES_H_ 1
+
+// Identifiers of the TableBot state machine states.
+#define TABLEBOT_STATE_SEARCH               0
+#define TABLEBOT_STATE_PUSH                 1
+#define TABLEBOT_STATE_ROTATE               2
+#define TABLEBOT_STATE_BACKAWAY             3
+#define TABLEBOT_STATE_TURNAWAY             4
+#define TABLEBOT_STATE_LOW_BATTERY          5
+#define TABLEBOT_STATE_AVOID                6
+
+// Identifiers of the camera state machine states.
+#define CAMERA_STATE_PING                   0
+#define CAMERA_STATE_PING_ACK               1
+#define CAMERA_STATE_ENABLE_TRACKING        2
+#define CAMERA_STATE_ENABLE_TRACKING_ACK    3
+#define CAMERA_STATE_TRACKING               4
+#define CAMERA_STATE_TRACKING_PACKET        5
+#define CAMERA_STATE_RESYNC                 6
+#define CAMERA_STATE_RESYNC_ACK             7
+#define CAMERA_STATE_FILTER                 8
+#define CAMERA_STATE_BAUD                   9
+#define CAMERA_STATE_BAUD_VERIFY            10
+
+#endif // _TB_STATES_H_
@@ -0,0 +1,226 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "clock.h"
+#include "latency.h"
+#include "telemetry.h"
+
+// Timer 2 clock select bits and the prescale they give.
+#define TELEMETRY_TIMER_CS          ((0<<CS22) | (1<<CS21) | (1<<CS20))
+#define TELEMETRY_TIMER_PRESCALE    ((TELEMETRY_TIMER_CS == 1) ? 1 :    \
+                                     (TELEMETRY_TIMER_CS == 2) ? 8 :    \
+                                     (TELEMETRY_TIMER_CS == 3) ? 32 :   \
+                                     (TELEMETRY_TIMER_CS == 4) ? 64 :   \
+                                     (TELEMETRY_TIMER_CS == 5) ? 128 :  \
+                                     (TELEMETRY_TIMER_CS == 6) ? 256 : 1024)
+
+// Soft UART bit time in timer 2 clocks.
+#define TELEMETRY_TIMER_CLOCK       (FOSC / TELEMETRY_TIMER_PRESCALE)
+#define TELEMETRY_TIMER_TOP         (((TELEMETRY_TIMER_CLOCK + (TELEMETRY_BAUD / 2)) / TELEMETRY_BAUD) - 1)
+
+#if (TELEMETRY_TIMER_TOP < 10) || (TELEMETRY_TIMER_TOP > 255)
+#error "TELEMETRY_BAUD is out of range"
+#endif
+
+// Transmit ring written by telemetry_send() and read by the interrupt.
+static uint8_t telemetry_buffer[TELEMETRY_BUFFER_SIZE];
+static volatile uint8_t telemetry_head;
+static volatile uint8_t telemetry_tail;
+
+// Byte being shifted out and the bit to send next.  Bit 0 is the start
+// bit, bits 1 to 8 are data and bit 9 is the stop bit.
+static uint8_t telemetry_byte;
+static uint8_t telemetry_bit;
+
+// Count of records dropped because the ring was full.
+static uint8_t telemetry_drops;
+
+void telemetry_init(void)
+{
+    // Initialize the transmit ring.
+    telemetry_head = 0;
+    telemetry_tail = 0;
+    telemetry_bit = 0;
+    telemetry_drops = 0;
+
+    // Enable PD7 as an output idling high.
+    PORTD |= (1<<PD7);
+    DDRD |= (1<<DDD7);
+
+    // Set the compare match A value to the bit time.
+    TCNT2 = 0;
+    OCR2A = TELEMETRY_TIMER_TOP;
+
+    // Set timer/counter2 control register A.
+    TCCR2A = (0<<COM2A1) | (0<<COM2A0) |                    // Disconnect OC2A.
+             (0<<COM2B1) | (0<<COM2B0) |                    // Disconnect OC2B.
+             (1<<WGM21) | (0<<WGM20);                       // Mode 2 - clear timer on compare match.
+
+    // Set timer/counter2 control register B.
+    TCCR2B = (0<<FOC2A) | (0<<FOC2B) |                      // No force output compare A or B.
+             (0<<WGM22) |                                   // Mode 2 - clear timer on compare match.
+             TELEMETRY_TIMER_CS;                            // Clk/32 prescale.
+
+    // The compare match interrupt is only enabled while sending.
+    TIMSK2 = 0;
+}
+
+
+uint8_t telemetry_send(const uint8_t* record, uint8_t length)
+// Frame the record and queue it for sending.  Never waits for the soft
+// UART.  Returns 1 for success or 0 if the record was dropped.
+{
+    uint8_t i;
+    uint8_t data;
+    uint8_t code;
+    uint8_t code_index;
+    uint8_t head;
+    uint8_t used;
+    uint8_t checksum;
+    uint8_t sreg;
+    uint8_t stamp;
+
+    // Sanity check the record length.
+    if ((length == 0) || (length > TELEMETRY_MAX_RECORD)) return 0;
+
+    // The frame is the record and checksum plus the code and delimiter bytes.
+    used = (telemetry_head - telemetry_tail) & (TELEMETRY_BUFFER_SIZE - 1);
+    if ((uint8_t) (length + 3) > (uint8_t) (TELEMETRY_BUFFER_SIZE - 1 - used))
+    {
+        // Count the dropped record.
+        if (telemetry_drops < 255) ++telemetry_drops;
+
+        return 0;
+    }
+
+    // Encode into the ring after the published head so the interrupt
+    // doesn't send the frame until it is complete.
+    head = telemetry_head;
+    code_index = head;
+    head = (head + 1) & (TELEMETRY_BUFFER_SIZE - 1);
+    code = 1;
+    checksum = 0;
+
+    // Encode the record followed by the checksum.
+    for (i = 0; i <= length; ++i)
+    {
+        // Get the next record byte or the checksum.
+        if (i < length)
+        {
+            data = record[i];
+            checksum += data;
+        }
+        else
+        {
+            data = (uint8_t) -checksum;
+        }
+
+        if (data)
+        {
+            // Copy the non-zero byte.
+            telemetry_buffer[head] = data;
+            head = (head + 1) & (TELEMETRY_BUFFER_SIZE - 1);
+            ++code;
+        }
+        else
+        {
+            // Replace the zero with the distance to the next zero.
+            telemetry_buffer[code_index] = code;
+            code_index = head;
+            head = (head + 1) & (TELEMETRY_BUFFER_SIZE - 1);
+            code = 1;
+        }
+    }
+
+    // Finish the last block and terminate the frame.
+    telemetry_buffer[code_index] = code;
+    telemetry_buffer[head] = 0;
+    head = (head + 1) & (TELEMETRY_BUFFER_SIZE - 1);
+
+    // Publish the frame.
+    telemetry_head = head;
+
+    // Start the soft UART if it is idle.  The bit timer is restarted and
+    // the compare match left over from the idle time is cleared so the
+    // first start bit lasts a full bit time.
+    sreg = SREG;
+    LATENCY_CLI(stamp);
+    if (!(TIMSK2 & (1<<OCIE2A)))
+    {
+        TCNT2 = 0;
+        TIFR2 = (1<<OCF2A);
+        TIMSK2 |= (1<<OCIE2A);
+    }
+    LATENCY_RESTORE(sreg, stamp);
+
+    return 1;
+}
+
+
+uint8_t telemetry_dropped(void)
+// Return the count of records dropped because the ring was full.
+{
+    return telemetry_drops;
+}
+
+
+SIGNAL(SIG_OUTPUT_COMPARE2A)
+// Handles timer/counter2 compare match A once per bit time.
+{
+    if (telemetry_bit == 0)
+    {
+        // Stop if there is nothing more to send.
+        if (telemetry_tail == telemetry_head)
+        {
+            TIMSK2 &= ~(1<<OCIE2A);
+            return;
+        }
+
+        // Get the next byte from the ring.
+        telemetry_byte = telemetry_buffer[telemetry_tail];
+        telemetry_tail = (telemetry_tail + 1) & (TELEMETRY_BUFFER_SIZE - 1);
+
+        // Send the start bit.
+        PORTD &= ~(1<<PD7);
+    }
+    else if (telemetry_bit < 9)
+    {
+        // Send the next data bit.
+        if (telemetry_byte & 0x01) PORTD |= (1<<PD7); else PORTD &= ~(1<<PD7);
+        telemetry_byte >>= 1;
+    }
+    else
+    {
+        // Send the stop bit.
+        PORTD |= (1<<PD7);
+        telemetry_bit = 0;
+        return;
+    }
+
+    ++telemetry_bit;
+}
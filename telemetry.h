@@ -0,0 +1,80 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_TELEMETRY_H_
+#define _TB_TELEMETRY_H_ 1
+
+// Telemetry is sent on PD7 by a soft UART clocked from timer 2, leaving
+// the USART to the camera.  The bit edges are set from the interrupt so
+// any interrupts disabled window shifts them.  The baud rate must be low
+// enough that the longest window, about 1000 cycles while the camera
+// packet is copied out of the receive buffer, stays well under half a
+// bit time.  Timer 2 runs at clk/32 so rates from 2400 to 38400 are
+// accurate to within 0.2% at 16 MHz.
+#define TELEMETRY_BAUD              4800
+
+// Status record period in 1/10th second ticks.
+#define TELEMETRY_PERIOD            5
+
+// Size of the transmit ring.  Must be a power of two.
+#define TELEMETRY_BUFFER_SIZE       64
+
+// Records are framed with consistent overhead byte stuffing (COBS) and
+// terminated with a zero byte.  The last byte of each record before
+// encoding is the two's complement of the sum of the record bytes.
+#define TELEMETRY_MAX_RECORD        32
+
+// Record types.
+#define TELEMETRY_RECORD_STATUS     1
+
+// Status record layout.  Multi-byte values are little endian.
+#define TELEMETRY_STATUS_TYPE       0           // TELEMETRY_RECORD_STATUS.
+#define TELEMETRY_STATUS_SEQUENCE   1           // Record sequence number.
+#define TELEMETRY_STATUS_TICKS      2           // 16-bit timer ticks.
+#define TELEMETRY_STATUS_TABLEBOT   4           // TableBot state machine state.
+#define TELEMETRY_STATUS_CAMERA     5           // Camera state machine state.
+#define TELEMETRY_STATUS_SENSORS    6           // Sensors state.
+#define TELEMETRY_STATUS_BLOB_SIZE  7           // 16-bit blob size.
+#define TELEMETRY_STATUS_BLOB_X     9           // Blob center.
+#define TELEMETRY_STATUS_BLOB_Y     10
+#define TELEMETRY_STATUS_PWM_A      11          // 16-bit signed motor PWM.
+#define TELEMETRY_STATUS_PWM_B      13
+#define TELEMETRY_STATUS_BATTERY    15          // 16-bit battery millivolts.
+#define TELEMETRY_STATUS_DROPPED    17          // Records dropped so far.
+#define TELEMETRY_STATUS_LINK_BYTES 18          // 16-bit camera bytes per second.
+#define TELEMETRY_STATUS_LINK_RATE  20          // Camera packets per second.
+#define TELEMETRY_STATUS_RECOVER    21          // 16-bit ticks to recover the camera link.
+#define TELEMETRY_STATUS_FIRST_BLOB 23          // 16-bit ticks from boot to the first blob.
+#define TELEMETRY_STATUS_RESYNCS    25          // Corrupt camera packets so far.
+#define TELEMETRY_STATUS_CONFIDENCE 26          // Target confidence.
+#define TELEMETRY_STATUS_STACK      27          // 16-bit stack bytes never used.
+#define TELEMETRY_STATUS_LENGTH     29
+
+void telemetry_init(void);
+uint8_t telemetry_send(const uint8_t* record, uint8_t length);
+uint8_t telemetry_dropped(void);
+
+#endif // _TB_TELEMETRY_H_
@@ -26,22 +26,29 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "latency.h"
+#include "profile.h"
 #include "timer.h"
+#include "sensors.h"
 
 volatile uint8_t timer_count;
-volatile uint8_t timer_ready;
 volatile uint8_t timer_rand;
 volatile uint16_t timer_wait[2];
+volatile uint16_t timer_ticks;
+
+#ifdef TIMER_VIRTUAL
+uint8_t timer_busy;
+#endif
 
 void timer_init(void)
 {
-    // Clear the timer count and ready flag.
+    // Clear the timer count.
     timer_count = 0;
-    timer_ready = 0;
+    timer_ticks = 0;
 
     // Set the compare match A value to yield an interrupt every 1/100th of a second.
     TCNT0 = 0;
-    OCR0A = 156;
+    OCR0A = TIMER_TICK_COUNTS - 1;
     OCR0B = 0;
 
     // Set timer/counter0 control register A.
@@ -64,18 +71,31 @@ void timer_init(void)
 SIGNAL(SIG_OUTPUT_COMPARE0A)
 // Handles timer/counter0 overflow.
 {
+#if LATENCY_ENABLE
+    // The timer cleared on the compare match so its count is the time
+    // since the match.
+    uint8_t entry = TCNT0;
+
+    latency_record(LATENCY_TIMER, 0);
+#endif
+
     // Increment the timer count.
     ++timer_count;
 
     // Increment the timer random.
     ++timer_rand;
 
+    // Increment the free running tick count.
+    ++timer_ticks;
+
+    // Sample and debounce the sensors.
+    profile_start(PROFILE_SENSORS);
+    sensors_update();
+    profile_end(PROFILE_SENSORS);
+
     // Have we reached 1/10th of a second?
     if (timer_count > 9)
     {
-        // Set the timer ready flag.
-        timer_ready = 1;
-
         // Decrement the timer wait.
         if (timer_wait[0]) --timer_wait[0];
         if (timer_wait[1]) --timer_wait[1];
@@ -83,4 +103,9 @@ SIGNAL(SIG_OUTPUT_COMPARE0A)
         // Reset the timer count.
         timer_count = 0;
     }
+
+#if LATENCY_ENABLE
+    // Record the time in the handler.
+    latency_record(LATENCY_TIMER_RUN, entry);
+#endif
 }
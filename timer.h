@@ -27,10 +27,24 @@
 #ifndef _MB_TIMER_H_
 #define _MB_TIMER_H_ 1
 
+// Timer0 prescale and the counts it makes in a second, 15625 at 16 MHz.
+#define TIMER_PRESCALE          1024UL
+#define TIMER_COUNTS_PER_SECOND (FOSC / TIMER_PRESCALE)
+
+// Timer0 counts of 64 us in each 1/100th second tick.
+#define TIMER_TICK_COUNTS       157
+
 // Declare externally so in-lines work.
-extern volatile uint8_t timer_ready;
 extern volatile uint8_t timer_rand;
 extern volatile uint16_t timer_wait[2];
+extern volatile uint16_t timer_ticks;
+
+#ifdef TIMER_VIRTUAL
+// Host builds run from a virtual clock in place of Timer0.  The clock
+// asks after each pass of the main loop whether any work was done so it
+// can skip the idle passes.  See FSM_RUN() in fsm.h.
+extern uint8_t timer_busy;
+#endif
 
 
 void timer_init(void);
@@ -42,17 +56,29 @@ inline static uint8_t timer_random(void)
 }
 
 
-inline static uint8_t timer_is_ready(void)
-// Return the timer ready flag.
+inline static uint16_t timer_get_ticks(void)
+// Return the free running count of 1/100th second ticks.
 {
-    return timer_ready;
+    uint8_t sreg;
+    uint16_t ticks;
+
+    // Disable interrupts while the 16-bit count is read.
+    sreg = SREG;
+    cli();
+
+    ticks = timer_ticks;
+
+    // Restore the interrupt state.
+    SREG = sreg;
+
+    return ticks;
 }
 
 
-inline static void timer_clear_ready(void)
-// Clear the timer ready flag.
+inline static uint8_t timer_ticks_passed(uint16_t deadline)
+// Return true once the free running tick count reaches the deadline.
 {
-    timer_ready = 0;
+    return ((int16_t) (timer_get_ticks() - deadline) >= 0) ? 1 : 0;
 }
 
 
@@ -70,4 +96,28 @@ inline static uint8_t timer_wait_done(uint8_t timer)
 }
 
 
+#ifdef TIMER_VIRTUAL
+inline static void timer_idle_begin(void)
+// Start watching a pass of the main loop for work.
+{
+    timer_busy = 0;
+}
+
+
+inline static void timer_work(void)
+// Note work which is not done by a state machine.
+{
+    ++timer_busy;
+}
+
+
+inline static uint8_t timer_idle(void)
+// Return true if every state machine run since timer_idle_begin() ended
+// blocked in a wait and no other work was noted.
+{
+    return timer_busy ? 0 : 1;
+}
+#endif
+
+
 #endif // _MB_TIMER_H_
@@ -26,9 +26,11 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "clock.h"
+#include "latency.h"
 #include "usart.h"
 
-#define XMIT_BUFFER_SIZE      16
+#define XMIT_BUFFER_SIZE      USART_XMIT_BUFFER_SIZE
 #define RECV_BUFFER_SIZE      64
 
 uint8_t xmit_buffer[XMIT_BUFFER_SIZE];
@@ -38,6 +40,10 @@ volatile uint8_t xmit_count;
 uint8_t recv_buffer[RECV_BUFFER_SIZE];
 volatile uint8_t recv_buf_start;
 volatile uint8_t recv_buf_end;
+volatile uint16_t recv_count;
+volatile uint16_t recv_errors;
+volatile uint16_t recv_overflows;
+volatile uint16_t recv_overruns;
 
 void usart_init(uint16_t ubrr)
 {
@@ -48,6 +54,10 @@ void usart_init(uint16_t ubrr)
     // Initialize the receive buffer variables.
     recv_buf_start = 0;
     recv_buf_end = 0;
+    recv_count = 0;
+    recv_errors = 0;
+    recv_overflows = 0;
+    recv_overruns = 0;
 
     // Set the baud rate.
     UBRR0 = ubrr;
@@ -66,6 +76,20 @@ void usart_init(uint16_t ubrr)
 }
 
 
+void usart_set_baud(uint16_t ubrr)
+// Change the baud rate.  Anything still being sent or received is lost.
+{
+    // Disable the receiver and transmitter.
+    UCSR0B &= ~((1<<RXEN0) | (1<<TXEN0));
+
+    // Set the baud rate.
+    UBRR0 = ubrr;
+
+    // Enable the receiver and transmitter.
+    UCSR0B |= (1<<RXEN0) | (1<<TXEN0);
+}
+
+
 uint8_t usart_xmit_ready(void)
 {
     // Return true if the transmit buffer is empty.
@@ -164,6 +188,13 @@ SIGNAL(SIG_USART_DATA)
 }
 
 
+uint8_t usart_recv_buffer_ready(void)
+// Returns 1 if the receive buffer holds any characters otherwise zero.
+{
+    return (recv_buf_start != recv_buf_end) ? 1 : 0;
+}
+
+
 uint8_t usart_recv_buffer_has_eol(uint8_t eol)
 // Returns 1 if the buffer contains an eol character otherwise zero.
 {
@@ -195,6 +226,7 @@ uint8_t usart_recv_buffer(char* buffer, uint8_t buflen, uint8_t eol)
 {
     uint8_t i;
     uint8_t count = 0;
+    uint8_t stamp;
 
     // Sanity check the buffer length.
     if ((buflen == 0) || (buflen > RECV_BUFFER_SIZE)) return 0;
@@ -203,7 +235,7 @@ uint8_t usart_recv_buffer(char* buffer, uint8_t buflen, uint8_t eol)
     if (recv_buf_start == recv_buf_end) return 0;
 
     // Clear interrupts.
-    cli();
+    LATENCY_CLI(stamp);
 
     // Read the buffer until it is filled, we hit the end of the receive
     // buffer or until we find and eol character.
@@ -226,18 +258,122 @@ uint8_t usart_recv_buffer(char* buffer, uint8_t buflen, uint8_t eol)
     }
 
     // Enable interrupts.
-    sei();
+    LATENCY_SEI(stamp);
+
+    return count;
+}
+
+
+void usart_recv_flush(void)
+// Discards any data in the receive buffer.
+{
+    uint8_t stamp;
+
+    // Clear interrupts.
+    LATENCY_CLI(stamp);
+
+    // Empty the buffer.
+    recv_buf_start = recv_buf_end;
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
+}
+
+
+uint16_t usart_recv_count(void)
+// Returns the free running count of characters received.
+{
+    uint16_t count;
+    uint8_t stamp;
+
+    // Clear interrupts.
+    LATENCY_CLI(stamp);
+
+    count = recv_count;
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
 
     return count;
 }
 
 
+uint16_t usart_recv_errors(void)
+// Returns the free running count of framing errors and data overruns.
+{
+    uint16_t errors;
+    uint8_t stamp;
+
+    // Clear interrupts.
+    LATENCY_CLI(stamp);
+
+    errors = recv_errors;
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
+
+    return errors;
+}
+
+
+uint16_t usart_recv_overflows(void)
+// Returns the free running count of characters lost because the receive
+// buffer was full.
+{
+    uint16_t overflows;
+    uint8_t stamp;
+
+    // Clear interrupts.
+    LATENCY_CLI(stamp);
+
+    overflows = recv_overflows;
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
+
+    return overflows;
+}
+
+
+uint16_t usart_recv_overruns(void)
+// Returns the free running count of data overruns, characters lost
+// because the receive interrupt was not serviced in time.
+{
+    uint16_t overruns;
+    uint8_t stamp;
+
+    // Clear interrupts.
+    LATENCY_CLI(stamp);
+
+    overruns = recv_overruns;
+
+    // Enable interrupts.
+    LATENCY_SEI(stamp);
+
+    return overruns;
+}
+
+
 SIGNAL(SIG_USART_RECV)
 // Handles the data received interrupt.
 {
+    uint8_t status;
+
+    // Count framing errors and data overruns.  The status must be read
+    // before the data.
+    status = UCSR0A;
+    if (status & ((1<<FE0) | (1<<DOR0))) ++recv_errors;
+
+    // Count the data overruns on their own.  An overrun means this
+    // interrupt was delayed too long.
+    if (status & (1<<DOR0)) ++recv_overruns;
+
     // Place the character into the recieve buffer.
     recv_buffer[recv_buf_end] = UDR0;
 
+    // Count the character.
+    ++recv_count;
+
     // Increment the receive buffer end.
     ++recv_buf_end;
 
@@ -252,5 +388,8 @@ SIGNAL(SIG_USART_RECV)
 
         // Wrap around if needed.
         recv_buf_start &= (RECV_BUFFER_SIZE - 1);
+
+        // Count the character lost.
+        ++recv_overflows;
     }
 }
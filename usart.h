@@ -27,19 +27,33 @@
 #ifndef _MB_USART_H_
 #define _MB_USART_H_ 1
 
-#define FOSC                16000000
-
-#define BAUD2UBRR_2400      832
-#define BAUD2UBRR_4800      416
-#define BAUD2UBRR_9600      207
-#define BAUD2UBRR_14400     138
-#define BAUD2UBRR_19200     103
-#define BAUD2UBRR_28800      68
-#define BAUD2UBRR_38400      51
-#define BAUD2UBRR_57600      34
-#define BAUD2UBRR_115200     16 
+// Baud rate to the camera at boot.
+#ifndef USART_BAUD
+#define USART_BAUD          115200
+#endif
+
+// Longest buffer usart_xmit_buffer() accepts.
+#define USART_XMIT_BUFFER_SIZE      24
+
+// UBRR value for a baud rate with the transfer rate doubler enabled,
+// rounded to the nearest value, and the error of the resulting rate in
+// 1/1000ths.  Both are constant for constant baud rates.
+#define USART_UBRR(baud)            (((FOSC) + (4UL * (baud))) / (8UL * (baud)) - 1)
+#define USART_ACTUAL_BAUD(baud)     ((FOSC) / (8UL * (USART_UBRR(baud) + 1)))
+#define USART_ERROR_PERMILLE(baud)  (((USART_ACTUAL_BAUD(baud) > (baud)) ?               \
+                                      (USART_ACTUAL_BAUD(baud) - (baud)) :               \
+                                      ((baud) - USART_ACTUAL_BAUD(baud))) * 1000 / (baud))
+
+// Largest baud rate error accepted.  The 115200 rate used with the camera
+// from the start is 2.1% off at 16 MHz.
+#define USART_ERROR_MAX_PERMILLE    25
+
+#if USART_ERROR_PERMILLE(USART_BAUD) > USART_ERROR_MAX_PERMILLE
+#error "USART_BAUD can not be generated accurately from FOSC"
+#endif
 
 void usart_init(uint16_t ubrr);
+void usart_set_baud(uint16_t ubrr);
 
 uint8_t usart_xmit_ready(void);
 uint8_t usart_recv_ready(void);
@@ -50,7 +64,13 @@ uint8_t usart_recv(void);
 uint8_t usart_xmit_buffer_ready(void);
 uint8_t usart_xmit_buffer(char* buffer, uint8_t buflen);
 
+uint8_t usart_recv_buffer_ready(void);
 uint8_t usart_recv_buffer_has_eol(uint8_t eol);
 uint8_t usart_recv_buffer(char* buffer, uint8_t buflen, uint8_t eol);
+void usart_recv_flush(void);
+uint16_t usart_recv_count(void);
+uint16_t usart_recv_errors(void);
+uint16_t usart_recv_overflows(void);
+uint16_t usart_recv_overruns(void);
 
 #endif // _MB_USART_H_
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include "watchdog.h"
+
+// Tasks which have checked in since the watchdog was last serviced.
+static uint8_t watchdog_tasks;
+
+void watchdog_init(void)
+// Start the watchdog.  Interrupts must be enabled so the timer keeps
+// the state machine ticking.
+{
+    // No tasks have checked in yet.
+    watchdog_tasks = 0;
+
+    // Enable the watchdog to reset the robot on timeout.
+    wdt_enable(WATCHDOG_TIMEOUT);
+}
+
+
+void watchdog_checkin(uint8_t task)
+// Check in a supervised task.
+{
+    watchdog_tasks |= task;
+}
+
+
+void watchdog_service(void)
+// Service the watchdog if every supervised task has checked in.  A stuck
+// task or a wedged main loop lets the watchdog reset the robot.
+{
+    if (watchdog_tasks == WATCHDOG_TASKS)
+    {
+        wdt_reset();
+        watchdog_tasks = 0;
+    }
+}
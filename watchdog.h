@@ -0,0 +1,42 @@
+/*
+    Copyright (c) 2006 Michael P. Thompson <mpthompson@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person 
+    obtaining a copy of this software and associated documentation 
+    files (the "Software"), to deal in the Software without 
+    restriction, including without limitation the rights to use, copy, 
+    modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be 
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+    DEALINGS IN THE SOFTWARE.
+
+    $Id:$
+*/
+
+#ifndef _TB_WATCHDOG_H_
+#define _TB_WATCHDOG_H_ 1
+
+// Supervised tasks.  Each must check in before the watchdog is serviced.
+#define WATCHDOG_TABLEBOT       0x01            // State machine tick.
+#define WATCHDOG_CAMERA         0x02            // Main loop camera polling.
+#define WATCHDOG_TASKS          (WATCHDOG_TABLEBOT | WATCHDOG_CAMERA)
+
+// Watchdog timeout.  The slowest task checks in every 1/10th second.
+#define WATCHDOG_TIMEOUT        WDTO_500MS
+
+void watchdog_init(void);
+void watchdog_checkin(uint8_t task);
+void watchdog_service(void);
+
+#endif // _TB_WATCHDOG_H_